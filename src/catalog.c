@@ -0,0 +1,705 @@
+/* catalog.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <lightdm.h>
+
+#include "shares.h"
+#include "catalog.h"
+#include "readahead.h"
+
+/* Types */
+
+typedef struct
+{
+    gchar*      atlas_path;
+    gchar*      stamp;
+    /* Result: NULL if there are no images */
+    GdkPixbuf*  atlas;
+    /* Result: areas of images, SESSION_IMAGES_GROUP */
+    GKeyFile*   areas;
+} SessionImagesBuildData;
+
+/* Static constants */
+
+/* LightDM defaults, used if "sessions-directory" and "remote-sessions-directory" are not set */
+static const gchar* const SESSIONS_DIRECTORY = "/usr/share/lightdm/sessions:/usr/share/xsessions:/usr/share/wayland-sessions";
+static const gchar* const REMOTE_SESSIONS_DIRECTORY = "/usr/share/lightdm/remote-sessions";
+
+/* Read in same order as LightDM does: later files override earlier ones */
+static const gchar* const LIGHTDM_CONFIG_DIRS[] =
+{
+    "/usr/share/lightdm/lightdm.conf.d",
+    "/etc/xdg/lightdm/lightdm.conf.d",
+    "/etc/lightdm/lightdm.conf.d",
+    NULL
+};
+static const gchar* const LIGHTDM_CONFIG_FILE = "/etc/lightdm/lightdm.conf";
+
+static const gchar* const LOCALES_PATHS[] =
+{
+    "/usr/lib/locale",
+    "/usr/lib/locale/locale-archive",
+    NULL
+};
+
+/* Sessions without own image use image of another session */
+static const struct
+{
+    const gchar* session;
+    const gchar* image;
+} SESSION_IMAGE_ALIASES[] =
+{
+    {"ubuntu-2d",      "ubuntu"},
+    {"gnome-classic",  "gnome"},
+    {"gnome-fallback", "gnome"},
+    {"gnome-shell",    "gnome"},
+    {"kde-plasma",     "kde"},
+    {NULL, NULL}
+};
+
+static const gchar* const SESSION_IMAGES_GROUP = "session-images";
+static const gchar* const SESSION_IMAGES_ATLAS = "session-images.png";
+
+/* Static variables */
+
+static struct
+{
+    GKeyFile*           cache;
+    gchar*              path;
+    gboolean            loaded;
+    /* Directories with session files, read from LightDM configuration */
+    gchar**             sessions_dirs;
+    SessionsCatalog*    sessions;
+    LanguagesCatalog*   languages;
+    /* All session images in one pixbuf, areas are listed in SESSION_IMAGES_GROUP of cache file */
+    GdkPixbuf*          session_images_atlas;
+    /* HashTable<session, GdkPixbuf*>, NULL value: session have no image */
+    GHashTable*         session_images;
+    /* Atlas is being rebuilt by worker thread */
+    gboolean            building_session_images;
+    SessionImagesCallback session_images_callback;
+} catalog_data;
+
+/* Static functions */
+
+static GKeyFile* get_cache_file                 (void);
+static void save_cache_file                     (void);
+static const gchar* const* get_sessions_dirs    (void);
+static void read_lightdm_config_file            (const gchar* path,
+                                                 gchar** sessions_directory,
+                                                 gchar** remote_sessions_directory);
+static void append_path_stamp                   (GString* stamp,
+                                                 const gchar* path,
+                                                 gboolean with_children);
+static gchar* get_sessions_stamp                (void);
+static gchar* get_languages_stamp               (void);
+static gchar** read_cached_list                 (const gchar* catalog,
+                                                 const gchar* key,
+                                                 guint length);
+static gchar* get_session_images_stamp          (void);
+static void load_session_images_atlas           (void);
+static void free_session_image                  (gpointer pixbuf);
+static void build_session_images_thread         (GTask* task,
+                                                 gpointer source_object,
+                                                 SessionImagesBuildData* data,
+                                                 GCancellable* cancellable);
+static void on_session_images_built             (GObject* source_object,
+                                                 GAsyncResult* result,
+                                                 gpointer user_data);
+static void free_session_images_build_data      (SessionImagesBuildData* data);
+static GdkPixbuf* build_session_images_atlas    (const gchar* atlas_path,
+                                                 GKeyFile* areas);
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+const SessionsCatalog* get_sessions_catalog(void)
+{
+    if(catalog_data.sessions)
+        return catalog_data.sessions;
+
+    SessionsCatalog* catalog = catalog_data.sessions = g_malloc0(sizeof(SessionsCatalog));
+    GKeyFile* cache = get_cache_file();
+    gchar* stamp = get_sessions_stamp();
+    gchar* cached_stamp = g_key_file_get_string(cache, "sessions", "stamp", NULL);
+
+    if(g_strcmp0(stamp, cached_stamp) == 0)
+    {
+        catalog->keys = g_key_file_get_string_list(cache, "sessions", "keys", NULL, NULL);
+        guint length = catalog->keys ? g_strv_length(catalog->keys) : 0;
+        catalog->names = read_cached_list("sessions", "names", length);
+        catalog->comments = read_cached_list("sessions", "comments", length);
+        if(catalog->keys && catalog->names && catalog->comments)
+        {
+            g_debug("Sessions catalog loaded from cache");
+            g_free(cached_stamp);
+            g_free(stamp);
+            return catalog;
+        }
+        g_strfreev(catalog->keys);
+        g_strfreev(catalog->names);
+        g_strfreev(catalog->comments);
+    }
+
+    g_message("Reading sessions catalog");
+    const GList* items = lightdm_get_sessions();
+    guint length = g_list_length((GList*)items);
+    catalog->keys = g_new0(gchar*, length + 1);
+    catalog->names = g_new0(gchar*, length + 1);
+    catalog->comments = g_new0(gchar*, length + 1);
+    for(guint i = 0; items != NULL; items = items->next, ++i)
+    {
+        catalog->keys[i] = g_strdup(lightdm_session_get_key(items->data));
+        catalog->names[i] = g_strdup(lightdm_session_get_name(items->data));
+        catalog->comments[i] = g_strdup(lightdm_session_get_comment(items->data));
+        /* Key file lists can not contain NULL, empty comment is read back as NULL */
+        if(!catalog->names[i])
+            catalog->names[i] = g_strdup(catalog->keys[i]);
+        if(!catalog->comments[i])
+            catalog->comments[i] = g_strdup("");
+    }
+
+    g_key_file_set_string(cache, "sessions", "stamp", stamp);
+    g_key_file_set_string_list(cache, "sessions", "keys", (const gchar* const*)catalog->keys, length);
+    g_key_file_set_string_list(cache, "sessions", "names", (const gchar* const*)catalog->names, length);
+    g_key_file_set_string_list(cache, "sessions", "comments", (const gchar* const*)catalog->comments, length);
+    save_cache_file();
+
+    g_free(cached_stamp);
+    g_free(stamp);
+    return catalog;
+}
+
+const LanguagesCatalog* get_languages_catalog(void)
+{
+    if(catalog_data.languages)
+        return catalog_data.languages;
+
+    LanguagesCatalog* catalog = catalog_data.languages = g_malloc0(sizeof(LanguagesCatalog));
+    GKeyFile* cache = get_cache_file();
+    gchar* stamp = get_languages_stamp();
+    gchar* cached_stamp = g_key_file_get_string(cache, "languages", "stamp", NULL);
+
+    if(g_strcmp0(stamp, cached_stamp) == 0)
+    {
+        catalog->codes = g_key_file_get_string_list(cache, "languages", "codes", NULL, NULL);
+        guint length = catalog->codes ? g_strv_length(catalog->codes) : 0;
+        catalog->labels = read_cached_list("languages", "labels", length);
+        if(catalog->codes && catalog->labels)
+        {
+            g_debug("Languages catalog loaded from cache");
+            g_free(cached_stamp);
+            g_free(stamp);
+            return catalog;
+        }
+        g_strfreev(catalog->codes);
+        g_strfreev(catalog->labels);
+        catalog->codes = catalog->labels = NULL;
+    }
+
+    g_message("Reading languages catalog");
+    const GList* items = lightdm_get_languages();
+    if(!items)
+    {
+        /* Not cached: list may become available on next start */
+        g_warning("lightdm_get_languages() return NULL");
+        g_free(cached_stamp);
+        g_free(stamp);
+        return catalog;
+    }
+
+    guint length = g_list_length((GList*)items);
+    catalog->codes = g_new0(gchar*, length + 1);
+    catalog->labels = g_new0(gchar*, length + 1);
+    for(guint i = 0; items != NULL; items = items->next, ++i)
+    {
+        catalog->codes[i] = g_strdup(lightdm_language_get_code(items->data));
+        catalog->labels[i] = get_language_label(catalog->codes[i]);
+    }
+
+    g_key_file_set_string(cache, "languages", "stamp", stamp);
+    g_key_file_set_string_list(cache, "languages", "codes", (const gchar* const*)catalog->codes, length);
+    g_key_file_set_string_list(cache, "languages", "labels", (const gchar* const*)catalog->labels, length);
+    save_cache_file();
+
+    g_free(cached_stamp);
+    g_free(stamp);
+    return catalog;
+}
+
+gboolean get_session_info(const gchar* key,
+                          gchar** name,
+                          gchar** comment)
+{
+    g_return_val_if_fail(key != NULL, FALSE);
+
+    const SessionsCatalog* catalog = catalog_data.sessions;
+    for(gint i = 0; catalog && catalog->keys && catalog->keys[i]; ++i)
+        if(g_strcmp0(catalog->keys[i], key) == 0)
+        {
+            *name = g_strdup(catalog->names[i]);
+            *comment = g_strdup(catalog->comments[i]);
+            return TRUE;
+        }
+
+    gchar* filename = g_strdup_printf("%s.desktop", key);
+    GKeyFile* key_file = g_key_file_new();
+    gboolean found = FALSE;
+    for(const gchar* const* dir = get_sessions_dirs(); *dir && !found; ++dir)
+    {
+        gchar* path = g_build_filename(*dir, filename, NULL);
+        if(g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL))
+        {
+            *name = g_key_file_get_locale_string(key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL, NULL);
+            *comment = g_key_file_get_locale_string(key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_COMMENT, NULL, NULL);
+            if(!*name)
+                *name = g_strdup(key);
+            if(!*comment)
+                *comment = g_strdup("");
+            found = TRUE;
+        }
+        g_free(path);
+    }
+    g_key_file_free(key_file);
+    g_free(filename);
+    return found;
+}
+
+gchar* get_language_label(const gchar* code)
+{
+    LightDMLanguage* language = g_object_new(LIGHTDM_TYPE_LANGUAGE, "code", code, NULL);
+    const gchar* country = lightdm_language_get_territory(language);
+    gchar* label = country ? g_strdup_printf("%s - %s", lightdm_language_get_name(language), country)
+                           : g_strdup(lightdm_language_get_name(language));
+    g_object_unref(language);
+
+    const gchar* modifier = strchr(code, '@');
+    if(modifier != NULL)
+    {
+        gchar* label_new = g_strdup_printf("%s [%s]", label, modifier + 1);
+        g_free(label);
+        label = label_new;
+    }
+    return label;
+}
+
+GdkPixbuf* get_session_image(const gchar* session)
+{
+    if(!catalog_data.session_images)
+        load_session_images_atlas();
+    if(catalog_data.building_session_images)
+        return NULL;
+
+    gpointer pixbuf = NULL;
+    if(g_hash_table_lookup_extended(catalog_data.session_images, session, NULL, &pixbuf))
+        return pixbuf;
+
+    gsize length = 0;
+    gint* area = catalog_data.session_images_atlas
+                 ? g_key_file_get_integer_list(catalog_data.cache, SESSION_IMAGES_GROUP, session, &length, NULL)
+                 : NULL;
+    if(area && length == 4 &&
+       area[0] >= 0 && area[1] >= 0 && area[2] > 0 && area[3] > 0 &&
+       area[0] + area[2] <= gdk_pixbuf_get_width(catalog_data.session_images_atlas) &&
+       area[1] + area[3] <= gdk_pixbuf_get_height(catalog_data.session_images_atlas))
+        pixbuf = gdk_pixbuf_new_subpixbuf(catalog_data.session_images_atlas, area[0], area[1], area[2], area[3]);
+    g_free(area);
+
+    g_hash_table_insert(catalog_data.session_images, g_strdup(session), pixbuf);
+    return pixbuf;
+}
+
+void set_session_images_callback(SessionImagesCallback callback)
+{
+    catalog_data.session_images_callback = callback;
+}
+
+void free_catalogs(void)
+{
+    if(catalog_data.sessions)
+    {
+        g_strfreev(catalog_data.sessions->keys);
+        g_strfreev(catalog_data.sessions->names);
+        g_strfreev(catalog_data.sessions->comments);
+        g_clear_pointer(&catalog_data.sessions, g_free);
+    }
+    if(catalog_data.languages)
+    {
+        g_strfreev(catalog_data.languages->codes);
+        g_strfreev(catalog_data.languages->labels);
+        g_clear_pointer(&catalog_data.languages, g_free);
+    }
+    g_clear_pointer(&catalog_data.sessions_dirs, g_strfreev);
+    g_clear_pointer(&catalog_data.session_images, g_hash_table_unref);
+    /* Result of running atlas build is dropped */
+    catalog_data.building_session_images = FALSE;
+    g_clear_object(&catalog_data.session_images_atlas);
+    g_clear_pointer(&catalog_data.cache, g_key_file_free);
+    g_clear_pointer(&catalog_data.path, g_free);
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static GKeyFile* get_cache_file(void)
+{
+    if(catalog_data.cache)
+        return catalog_data.cache;
+
+    gchar* cache_dir = g_build_filename(g_get_user_cache_dir(), APP_NAME, NULL);
+    g_mkdir_with_parents(cache_dir, 0775);
+    catalog_data.path = g_build_filename(cache_dir, "catalog", NULL);
+    readahead_note_file(catalog_data.path);
+    catalog_data.cache = g_key_file_new();
+
+    GError* error = NULL;
+    g_key_file_load_from_file(catalog_data.cache, catalog_data.path, G_KEY_FILE_NONE, &error);
+    if(error && !g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning("Failed to load catalog cache from %s: %s", catalog_data.path, error->message);
+    g_clear_error(&error);
+
+    /* Cache written by another version may contain different labels */
+    gchar* version = g_key_file_get_string(catalog_data.cache, "catalog", "version", NULL);
+    if(g_strcmp0(version, PACKAGE_VERSION) != 0)
+    {
+        g_key_file_free(catalog_data.cache);
+        catalog_data.cache = g_key_file_new();
+        g_key_file_set_string(catalog_data.cache, "catalog", "version", PACKAGE_VERSION);
+    }
+    g_free(version);
+    g_free(cache_dir);
+    return catalog_data.cache;
+}
+
+static void save_cache_file(void)
+{
+    gsize data_length = 0;
+    gchar* data = g_key_file_to_data(catalog_data.cache, &data_length, NULL);
+
+    g_return_if_fail(data != NULL);
+
+    GError* error = NULL;
+    if(!g_file_set_contents(catalog_data.path, data, data_length, &error))
+    {
+        g_warning("Failed to save catalog cache: %s", error->message);
+        g_clear_error(&error);
+    }
+    g_free(data);
+}
+
+static const gchar* const* get_sessions_dirs(void)
+{
+    if(catalog_data.sessions_dirs)
+        return (const gchar* const*)catalog_data.sessions_dirs;
+
+    gchar* sessions_directory = g_strdup(SESSIONS_DIRECTORY);
+    gchar* remote_sessions_directory = g_strdup(REMOTE_SESSIONS_DIRECTORY);
+    for(const gchar* const* path = LIGHTDM_CONFIG_DIRS; *path; ++path)
+    {
+        GDir* dir = g_dir_open(*path, 0, NULL);
+        if(!dir)
+            continue;
+        GList* files = NULL;
+        for(const gchar* name = g_dir_read_name(dir); name != NULL; name = g_dir_read_name(dir))
+            if(g_str_has_suffix(name, ".conf"))
+                files = g_list_insert_sorted(files, g_build_filename(*path, name, NULL), (GCompareFunc)g_strcmp0);
+        g_dir_close(dir);
+        for(GList* file = files; file != NULL; file = file->next)
+            read_lightdm_config_file(file->data, &sessions_directory, &remote_sessions_directory);
+        g_list_free_full(files, g_free);
+    }
+    read_lightdm_config_file(LIGHTDM_CONFIG_FILE, &sessions_directory, &remote_sessions_directory);
+
+    gchar* directories = g_strdup_printf("%s:%s", sessions_directory, remote_sessions_directory);
+    catalog_data.sessions_dirs = g_strsplit(directories, ":", -1);
+    g_free(directories);
+    g_free(sessions_directory);
+    g_free(remote_sessions_directory);
+    return (const gchar* const*)catalog_data.sessions_dirs;
+}
+
+static void read_lightdm_config_file(const gchar* path,
+                                     gchar** sessions_directory,
+                                     gchar** remote_sessions_directory)
+{
+    GKeyFile* key_file = g_key_file_new();
+    if(g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL))
+    {
+        gchar* value = g_key_file_get_string(key_file, "LightDM", "sessions-directory", NULL);
+        if(value)
+        {
+            g_free(*sessions_directory);
+            *sessions_directory = value;
+        }
+        value = g_key_file_get_string(key_file, "LightDM", "remote-sessions-directory", NULL);
+        if(value)
+        {
+            g_free(*remote_sessions_directory);
+            *remote_sessions_directory = value;
+        }
+    }
+    g_key_file_free(key_file);
+}
+
+/* Directory mtime changes only when files are added or removed, so mtimes of children are used too */
+static void append_path_stamp(GString* stamp,
+                              const gchar* path,
+                              gboolean with_children)
+{
+    GStatBuf st;
+    if(g_stat(path, &st) != 0)
+        return;
+    g_string_append_printf(stamp, "%s:%" G_GINT64_FORMAT ";", path, (gint64)st.st_mtime);
+
+    GDir* dir = with_children ? g_dir_open(path, 0, NULL) : NULL;
+    if(!dir)
+        return;
+    gint64 max_mtime = 0;
+    guint count = 0;
+    for(const gchar* name = g_dir_read_name(dir); name != NULL; name = g_dir_read_name(dir))
+    {
+        gchar* child_path = g_build_filename(path, name, NULL);
+        if(g_stat(child_path, &st) == 0)
+            max_mtime = MAX(max_mtime, (gint64)st.st_mtime);
+        g_free(child_path);
+        ++count;
+    }
+    g_dir_close(dir);
+    g_string_append_printf(stamp, "%u:%" G_GINT64_FORMAT ";", count, max_mtime);
+}
+
+static gchar* get_sessions_stamp(void)
+{
+    GString* stamp = g_string_new(NULL);
+    for(const gchar* const* path = get_sessions_dirs(); *path; ++path)
+        append_path_stamp(stamp, *path, TRUE);
+    /* Names and comments are localized */
+    g_string_append_printf(stamp, "%s;%s", g_getenv("LANG") ? g_getenv("LANG") : "",
+                                           g_getenv("LANGUAGE") ? g_getenv("LANGUAGE") : "");
+    return g_string_free(stamp, FALSE);
+}
+
+static gchar* get_languages_stamp(void)
+{
+    GString* stamp = g_string_new(NULL);
+    for(const gchar* const* path = LOCALES_PATHS; *path; ++path)
+        append_path_stamp(stamp, *path, FALSE);
+    /* Labels are formatted using current locale */
+    g_string_append_printf(stamp, "%s;%s", g_getenv("LANG") ? g_getenv("LANG") : "",
+                                           g_getenv("LANGUAGE") ? g_getenv("LANGUAGE") : "");
+    return g_string_free(stamp, FALSE);
+}
+
+static gchar** read_cached_list(const gchar* catalog,
+                                const gchar* key,
+                                guint length)
+{
+    gsize list_length = 0;
+    gchar** list = g_key_file_get_string_list(catalog_data.cache, catalog, key, &list_length, NULL);
+    if(list && list_length != length)
+        g_clear_pointer(&list, g_strfreev);
+    return list;
+}
+
+/* Images replaced in place do not change directory mtime, so every image is stamped */
+static gchar* get_session_images_stamp(void)
+{
+    GString* stamp = g_string_new(NULL);
+    append_path_stamp(stamp, GREETER_DATA_DIR, FALSE);
+
+    GDir* dir = g_dir_open(GREETER_DATA_DIR, 0, NULL);
+    for(const gchar* name = dir ? g_dir_read_name(dir) : NULL; name != NULL; name = g_dir_read_name(dir))
+    {
+        if(!g_str_has_suffix(name, ".png"))
+            continue;
+        gchar* path = g_build_filename(GREETER_DATA_DIR, name, NULL);
+        GStatBuf st;
+        if(g_stat(path, &st) == 0)
+            g_string_append_printf(stamp, "%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ";",
+                                   name, (gint64)st.st_mtime, (gint64)st.st_size);
+        g_free(path);
+    }
+    if(dir)
+        g_dir_close(dir);
+    return g_string_free(stamp, FALSE);
+}
+
+/* Atlas is rebuilt only when session images are modified: one stat() per image and one image read per start */
+static void load_session_images_atlas(void)
+{
+    catalog_data.session_images = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_session_image);
+
+    GKeyFile* cache = get_cache_file();
+    gchar* atlas_path = g_build_filename(g_get_user_cache_dir(), APP_NAME, SESSION_IMAGES_ATLAS, NULL);
+    gchar* stamp = get_session_images_stamp();
+    gchar* cached_stamp = g_key_file_get_string(cache, SESSION_IMAGES_GROUP, "stamp", NULL);
+
+    gboolean valid = g_strcmp0(stamp, cached_stamp) == 0;
+    gboolean have_images = g_key_file_get_boolean(cache, SESSION_IMAGES_GROUP, "have-images", NULL);
+    readahead_note_file(atlas_path);
+    if(valid && have_images)
+        catalog_data.session_images_atlas = gdk_pixbuf_new_from_file(atlas_path, NULL);
+
+    if(!valid || (have_images && !catalog_data.session_images_atlas))
+    {
+        /* Decoding all images takes time: rows are updated by session_images_callback */
+        g_message("Building session images atlas");
+        SessionImagesBuildData* data = g_malloc0(sizeof(SessionImagesBuildData));
+        data->atlas_path = g_strdup(atlas_path);
+        data->stamp = g_strdup(stamp);
+        data->areas = g_key_file_new();
+        catalog_data.building_session_images = TRUE;
+
+        GTask* task = g_task_new(NULL, NULL, on_session_images_built, NULL);
+        g_task_set_task_data(task, data, (GDestroyNotify)free_session_images_build_data);
+        g_task_run_in_thread(task, (GTaskThreadFunc)build_session_images_thread);
+        g_object_unref(task);
+    }
+
+    g_free(cached_stamp);
+    g_free(stamp);
+    g_free(atlas_path);
+}
+
+static void build_session_images_thread(GTask* task,
+                                        gpointer source_object,
+                                        SessionImagesBuildData* data,
+                                        GCancellable* cancellable)
+{
+    data->atlas = build_session_images_atlas(data->atlas_path, data->areas);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_session_images_built(GObject* source_object,
+                                    GAsyncResult* result,
+                                    gpointer user_data)
+{
+    SessionImagesBuildData* data = g_task_get_task_data(G_TASK(result));
+    /* Catalogs were freed while atlas was built */
+    if(!catalog_data.building_session_images || !catalog_data.session_images)
+        return;
+    catalog_data.building_session_images = FALSE;
+
+    GKeyFile* cache = get_cache_file();
+    g_key_file_remove_group(cache, SESSION_IMAGES_GROUP, NULL);
+    gchar** sessions = g_key_file_get_keys(data->areas, SESSION_IMAGES_GROUP, NULL, NULL);
+    for(gchar** session = sessions; session && *session; ++session)
+    {
+        gchar* area = g_key_file_get_value(data->areas, SESSION_IMAGES_GROUP, *session, NULL);
+        g_key_file_set_value(cache, SESSION_IMAGES_GROUP, *session, area);
+        g_free(area);
+    }
+    g_strfreev(sessions);
+    g_key_file_set_string(cache, SESSION_IMAGES_GROUP, "stamp", data->stamp);
+    g_key_file_set_boolean(cache, SESSION_IMAGES_GROUP, "have-images", data->atlas != NULL);
+    save_cache_file();
+
+    g_clear_object(&catalog_data.session_images_atlas);
+    catalog_data.session_images_atlas = data->atlas ? g_object_ref(data->atlas) : NULL;
+    g_hash_table_remove_all(catalog_data.session_images);
+    if(catalog_data.session_images_callback)
+        catalog_data.session_images_callback();
+}
+
+static void free_session_images_build_data(SessionImagesBuildData* data)
+{
+    g_clear_object(&data->atlas);
+    g_key_file_free(data->areas);
+    g_free(data->stamp);
+    g_free(data->atlas_path);
+    g_free(data);
+}
+
+/* Packs all <session>.png images from GREETER_DATA_DIR into one row, areas are stored to SESSION_IMAGES_GROUP.
+   Returns NULL if there are no images. Called from worker thread */
+static GdkPixbuf* build_session_images_atlas(const gchar* atlas_path,
+                                             GKeyFile* areas)
+{
+    GDir* dir = g_dir_open(GREETER_DATA_DIR, 0, NULL);
+    if(!dir)
+        return NULL;
+
+    GSList* images = NULL;
+    gint width = 0, height = 0;
+    for(const gchar* name = g_dir_read_name(dir); name != NULL; name = g_dir_read_name(dir))
+    {
+        /* Key file keys can not contain these characters */
+        if(!g_str_has_suffix(name, ".png") || strpbrk(name, "[]= "))
+            continue;
+        gchar* path = g_build_filename(GREETER_DATA_DIR, name, NULL);
+        GdkPixbuf* pixbuf = gdk_pixbuf_new_from_file(path, NULL);
+        g_free(path);
+        if(!pixbuf)
+            continue;
+        g_object_set_data_full(G_OBJECT(pixbuf), "session", g_strndup(name, strlen(name) - strlen(".png")), g_free);
+        images = g_slist_prepend(images, pixbuf);
+        width += gdk_pixbuf_get_width(pixbuf);
+        height = MAX(height, gdk_pixbuf_get_height(pixbuf));
+    }
+    g_dir_close(dir);
+
+    if(!images)
+        return NULL;
+
+    GdkPixbuf* atlas = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, width, height);
+    gdk_pixbuf_fill(atlas, 0);
+    gint x = 0;
+    for(GSList* item = images; item != NULL; item = item->next)
+    {
+        GdkPixbuf* pixbuf = item->data;
+        gint area[4] = {x, 0, gdk_pixbuf_get_width(pixbuf), gdk_pixbuf_get_height(pixbuf)};
+        gdk_pixbuf_copy_area(pixbuf, 0, 0, area[2], area[3], atlas, x, 0);
+        g_key_file_set_integer_list(areas, SESSION_IMAGES_GROUP,
+                                    g_object_get_data(G_OBJECT(pixbuf), "session"), area, 4);
+        x += area[2];
+    }
+    g_slist_free_full(images, g_object_unref);
+
+    for(gint i = 0; SESSION_IMAGE_ALIASES[i].session; ++i)
+    {
+        if(g_key_file_has_key(areas, SESSION_IMAGES_GROUP, SESSION_IMAGE_ALIASES[i].session, NULL))
+            continue;
+        gchar* area = g_key_file_get_value(areas, SESSION_IMAGES_GROUP, SESSION_IMAGE_ALIASES[i].image, NULL);
+        if(area)
+            g_key_file_set_value(areas, SESSION_IMAGES_GROUP, SESSION_IMAGE_ALIASES[i].session, area);
+        g_free(area);
+    }
+
+    GError* error = NULL;
+    if(!gdk_pixbuf_save(atlas, atlas_path, "png", &error, NULL))
+    {
+        g_warning("Failed to save session images atlas: %s", error->message);
+        g_clear_error(&error);
+    }
+    return atlas;
+}
+
+static void free_session_image(gpointer pixbuf)
+{
+    if(pixbuf)
+        g_object_unref(pixbuf);
+}
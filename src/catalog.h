@@ -0,0 +1,62 @@
+/* catalog.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CATALOG_H_INCLUDED_
+#define _CATALOG_H_INCLUDED_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Types */
+
+/* All lists are NULL-terminated and have same length */
+typedef struct
+{
+    gchar** keys;
+    gchar** names;
+    gchar** comments;
+} SessionsCatalog;
+
+typedef struct
+{
+    /* NULL if no languages available */
+    gchar** codes;
+    gchar** labels;
+} LanguagesCatalog;
+
+/* Called when session images atlas is rebuilt in background */
+typedef void (*SessionImagesCallback)          (void);
+
+/* Functions */
+
+/* Catalogs are read from cache file if it is up to date, otherwise from liblightdm */
+const SessionsCatalog* get_sessions_catalog    (void);
+const LanguagesCatalog* get_languages_catalog  (void);
+/* Reads name and comment of one session from catalog if it is loaded, otherwise from <key>.desktop */
+gboolean get_session_info                      (const gchar* key,
+                                                gchar** name,
+                                                gchar** comment);
+gchar* get_language_label                      (const gchar* code);
+/* Returns session image from atlas (owned by catalog) or NULL.
+   Outdated atlas is rebuilt in worker thread, NULL is returned until callback is called */
+GdkPixbuf* get_session_image                   (const gchar* session);
+void set_session_images_callback               (SessionImagesCallback callback);
+void free_catalogs                             (void);
+
+#endif // _CATALOG_H_INCLUDED_
@@ -18,8 +18,11 @@
  */
 
 #include "configuration.h"
+#include "readahead.h"
+#include "watchdog.h"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <string.h>
 
 /* Variables */
@@ -47,10 +50,28 @@ typedef struct
     gchar* css_path;
 } LoadedGreeterConfig;
 
+typedef enum
+{
+    SNAPSHOT_FIELD_BOOL,
+    SNAPSHOT_FIELD_INT,
+    SNAPSHOT_FIELD_STR,
+    SNAPSHOT_FIELD_STRV,
+    SNAPSHOT_FIELD_POSITION
+} SnapshotFieldType;
+
+/* Plain field of GreeterConfig stored in snapshot */
+typedef struct
+{
+    const gchar*      key;
+    SnapshotFieldType type;
+    gsize             offset;
+} SnapshotField;
+
 /* Static functions */
 
 static void save_key_file                          (GKeyFile* key_file,
                                                     const gchar* path);
+static void save_state                             (void);
 
 static void read_appearance_section                (GKeyFile* key_file,
                                                     const gchar* section,
@@ -125,11 +146,19 @@ static gchar* read_value_path                      (GKeyFile* key_file,
                                                     const gchar* default_value,
                                                     const gchar* dir);
 
-static GtkStyleProvider* read_css_file             (const gchar* path,
-                                                    GdkScreen* screen);
+static GtkStyleProvider* read_css_file             (const gchar* path);
+static GSList* get_style_variant                   (const gchar* gtk_theme);
 
 static void read_templates                         (void);
 
+static void load_themes_bundle                     (void);
+
+static void add_consulted_file                     (const gchar* path);
+static void snapshot_gtk_setting                   (const gchar* property,
+                                                    GVariant* value);
+static gboolean load_config_snapshot               (void);
+static void save_config_snapshot                   (void);
+
 void update_default_user_image                     (void);
 
 /* Static variables */
@@ -138,6 +167,9 @@ static struct
 {
     GKeyFile* config;
     gchar* path;
+    /* Number of freeze_state() calls without thaw_state() */
+    gint freeze_count;
+    gboolean changed;
 } state_data;
 
 /* Hash set used to control infinite recursive configs reading
@@ -145,6 +177,23 @@ static struct
    freed: load_settings() */
 static GHashTable* loaded_themes = NULL;
 
+/* Compiled themes (themes.gresource), registered in load_themes_bundle() */
+static GResource* themes_bundle = NULL;
+/* Installed files modified after bundle was built are used instead of bundled ones */
+static gint64 themes_bundle_mtime = 0;
+
+/* Data collected while parsing configuration files, see save_config_snapshot() */
+static struct
+{
+    /* Files that affect configuration: GVariant "(stxx)": path, inode, mtime, size */
+    GVariantBuilder* files;
+    GHashTable*      files_set;
+    /* GtkSettings properties changed while reading configuration */
+    GVariantBuilder* gtk_settings;
+    /* Do not save snapshot if reading produced errors: they must be reported again */
+    gboolean         allowed;
+} snapshot_data;
+
 /* Static constants */
 
 static const gchar* USER_NAME_FORMAT_STRINGS[] = {"name", "display-name", "both", NULL};
@@ -152,6 +201,14 @@ static const gchar* PANEL_POSITION_STRINGS[]   = {"top", "bottom", NULL};
 static const gchar* ONBOARD_POSITION_STRINGS[] = {"top", "bottom", "panel", "opposite", NULL};
 static const gchar* USER_IMAGE_FIT_STRINGS[]   = {"none", "all", "bigger", "smaller", NULL};
 static const gchar* POWER_ACTION_STRINGS[]     = {"none", "suspend", "hibernate", "restart", "shutdown", NULL};
+static const gchar* LAYOUT_BACKEND_STRINGS[]   = {"xklavier", "xkb", NULL};
+
+static const gchar* THEMES_BUNDLE_FILE         = "themes.gresource";
+static const gchar* CONFIG_SNAPSHOT_FILE       = "config-snapshot";
+/* Increment on any change of GreeterConfig or snapshot format */
+static const guint32 CONFIG_SNAPSHOT_VERSION   = 7;
+#define CONFIG_SNAPSHOT_TYPE                   "(sua(stxx)a{sv})"
+static const gchar* THEMES_BUNDLE_PREFIX       = "/lightdm-another-gtk-greeter";
 
 #if GTK_CHECK_VERSION(3, 10, 0)
 static const gchar* SESSION_COLUMN_STRINGS[]   = {"name", "display-name", "image", "comment", NULL};
@@ -160,6 +217,99 @@ static const gchar* USER_COLUMN_STRINGS[]      = {"name", "type", "display-name"
                                                   "logged-in", NULL};
 #endif
 
+#define SNAPSHOT_FIELD(key, type, field) {key, SNAPSHOT_FIELD_##type, G_STRUCT_OFFSET(GreeterConfig, field)}
+
+/* themes_stack, templates and GtkSettings are stored separately */
+static const SnapshotField SNAPSHOT_FIELDS[] =
+{
+    SNAPSHOT_FIELD("greeter.allow-other-users",             BOOL,     greeter.allow_other_users),
+    SNAPSHOT_FIELD("greeter.show-language-selector",        BOOL,     greeter.show_language_selector),
+    SNAPSHOT_FIELD("greeter.show-session-icon",             BOOL,     greeter.show_session_icon),
+    SNAPSHOT_FIELD("greeter.double-escape-time",            INT,      greeter.double_escape_time),
+    SNAPSHOT_FIELD("greeter.allow-password-toggle",         BOOL,     greeter.allow_password_toggle),
+    SNAPSHOT_FIELD("greeter.recent-users-limit",            INT,      greeter.recent_users_limit),
+    SNAPSHOT_FIELD("greeter.themes-bundle",                 BOOL,     greeter.themes_bundle),
+    SNAPSHOT_FIELD("greeter.readahead",                     BOOL,     greeter.readahead),
+    SNAPSHOT_FIELD("greeter.idle-timeout",                  INT,      greeter.idle_timeout),
+    SNAPSHOT_FIELD("greeter.screenshot-format",             STR,      greeter.screenshot_format),
+    SNAPSHOT_FIELD("greeter.screenshot-compression",        INT,      greeter.screenshot_compression),
+    SNAPSHOT_FIELD("greeter.watchdog-threshold",            INT,      greeter.watchdog_threshold),
+    SNAPSHOT_FIELD("greeter.watchdog-backtrace",            BOOL,     greeter.watchdog_backtrace),
+
+    SNAPSHOT_FIELD("appearance.ui-file",                    STR,      appearance.ui_file),
+    SNAPSHOT_FIELD("appearance.messagebox-ui-file",         STR,      appearance.messagebox_ui_file),
+    SNAPSHOT_FIELD("appearance.onboard-ui-file",            STR,      appearance.onboard_ui_file),
+    SNAPSHOT_FIELD("appearance.gtk-theme",                  STR,      appearance.gtk_theme),
+    SNAPSHOT_FIELD("appearance.icon-theme",                 STR,      appearance.icon_theme),
+    SNAPSHOT_FIELD("appearance.background",                 STR,      appearance.background),
+    SNAPSHOT_FIELD("appearance.user-background",            BOOL,     appearance.user_background),
+    SNAPSHOT_FIELD("appearance.x-background",               BOOL,     appearance.x_background),
+    SNAPSHOT_FIELD("appearance.logo",                       STR,      appearance.logo),
+    SNAPSHOT_FIELD("appearance.user-name-format",           INT,      appearance.user_name_format),
+    SNAPSHOT_FIELD("appearance.date-format",                STR,      appearance.date_format),
+    SNAPSHOT_FIELD("appearance.fixed-login-button-width",   BOOL,     appearance.fixed_login_button_width),
+    SNAPSHOT_FIELD("appearance.font",                       STR,      appearance.font),
+    SNAPSHOT_FIELD("appearance.hintstyle",                  STR,      appearance.hintstyle),
+    SNAPSHOT_FIELD("appearance.rgba",                       STR,      appearance.rgba),
+    SNAPSHOT_FIELD("appearance.antialias",                  BOOL,     appearance.antialias),
+    SNAPSHOT_FIELD("appearance.dpi",                        INT,      appearance.dpi),
+    SNAPSHOT_FIELD("appearance.transparency",               BOOL,     appearance.transparency),
+    SNAPSHOT_FIELD("appearance.position",                   POSITION, appearance.position),
+    SNAPSHOT_FIELD("appearance.position-is-relative",       BOOL,     appearance.position_is_relative),
+    SNAPSHOT_FIELD("appearance.hide-prompt-text",           BOOL,     appearance.hide_prompt_text),
+    SNAPSHOT_FIELD("appearance.user-image.enabled",         BOOL,     appearance.user_image.enabled),
+    SNAPSHOT_FIELD("appearance.user-image.fit",             INT,      appearance.user_image.fit),
+    SNAPSHOT_FIELD("appearance.user-image.size",            INT,      appearance.user_image.size),
+    SNAPSHOT_FIELD("appearance.list-image.enabled",         BOOL,     appearance.list_image.enabled),
+    SNAPSHOT_FIELD("appearance.list-image.fit",             INT,      appearance.list_image.fit),
+    SNAPSHOT_FIELD("appearance.list-image.size",            INT,      appearance.list_image.size),
+    SNAPSHOT_FIELD("appearance.invert-password-state",      BOOL,     appearance.invert_password_state),
+    SNAPSHOT_FIELD("appearance.default-user-image",         STR,      appearance.default_user_image),
+
+    SNAPSHOT_FIELD("panel.enabled",                         BOOL,     panel.enabled),
+    SNAPSHOT_FIELD("panel.position",                        INT,      panel.position),
+
+    SNAPSHOT_FIELD("power.enabled",                         BOOL,     power.enabled),
+    SNAPSHOT_FIELD("power.button-press-action",             INT,      power.button_press_action),
+    SNAPSHOT_FIELD("power.suspend-prompt",                  BOOL,     power.prompts[POWER_ACTION_SUSPEND]),
+    SNAPSHOT_FIELD("power.hibernate-prompt",                BOOL,     power.prompts[POWER_ACTION_HIBERNATE]),
+    SNAPSHOT_FIELD("power.restart-prompt",                  BOOL,     power.prompts[POWER_ACTION_RESTART]),
+    SNAPSHOT_FIELD("power.shutdown-prompt",                 BOOL,     power.prompts[POWER_ACTION_SHUTDOWN]),
+
+    SNAPSHOT_FIELD("clock.enabled",                         BOOL,     clock.enabled),
+    SNAPSHOT_FIELD("clock.calendar",                        BOOL,     clock.calendar),
+    SNAPSHOT_FIELD("clock.time-format",                     STR,      clock.time_format),
+    SNAPSHOT_FIELD("clock.date-format",                     STR,      clock.date_format),
+
+    SNAPSHOT_FIELD("a11y.enabled",                          BOOL,     a11y.enabled),
+    SNAPSHOT_FIELD("a11y.contrast.enabled",                 BOOL,     a11y.contrast.enabled),
+    SNAPSHOT_FIELD("a11y.contrast.gtk-theme",               STR,      a11y.contrast.gtk_theme),
+    SNAPSHOT_FIELD("a11y.contrast.icon-theme",              STR,      a11y.contrast.icon_theme),
+    SNAPSHOT_FIELD("a11y.contrast.initial-state",           BOOL,     a11y.contrast.initial_state),
+    SNAPSHOT_FIELD("a11y.osk.enabled",                      BOOL,     a11y.osk.enabled),
+    SNAPSHOT_FIELD("a11y.osk.command",                      STRV,     a11y.osk.command),
+    SNAPSHOT_FIELD("a11y.osk.use-onboard",                  BOOL,     a11y.osk.use_onboard),
+    SNAPSHOT_FIELD("a11y.osk.initial-state",                BOOL,     a11y.osk.initial_state),
+    SNAPSHOT_FIELD("a11y.osk.onboard-position",             INT,      a11y.osk.onboard_position),
+    SNAPSHOT_FIELD("a11y.osk.onboard-height",               INT,      a11y.osk.onboard_height),
+    SNAPSHOT_FIELD("a11y.osk.onboard-height-is-percent",    BOOL,     a11y.osk.onboard_height_is_percent),
+    SNAPSHOT_FIELD("a11y.font.enabled",                     BOOL,     a11y.font.enabled),
+    SNAPSHOT_FIELD("a11y.font.increment",                   INT,      a11y.font.increment),
+    SNAPSHOT_FIELD("a11y.font.is-percent",                  BOOL,     a11y.font.is_percent),
+    SNAPSHOT_FIELD("a11y.font.initial-state",               BOOL,     a11y.font.initial_state),
+    SNAPSHOT_FIELD("a11y.dpi.enabled",                      BOOL,     a11y.dpi.enabled),
+    SNAPSHOT_FIELD("a11y.dpi.increment",                    INT,      a11y.dpi.increment),
+    SNAPSHOT_FIELD("a11y.dpi.is-percent",                   BOOL,     a11y.dpi.is_percent),
+    SNAPSHOT_FIELD("a11y.dpi.initial-state",                BOOL,     a11y.dpi.initial_state),
+
+    SNAPSHOT_FIELD("layout.enabled",                        BOOL,     layout.enabled),
+    SNAPSHOT_FIELD("layout.enabled-for-one",                BOOL,     layout.enabled_for_one),
+    SNAPSHOT_FIELD("layout.backend",                        INT,      layout.backend),
+    {NULL, 0, 0}
+};
+
+#undef SNAPSHOT_FIELD
+
 static const ModelPropertyBinding SESSION_TEMPLATE_DEFAULT_BINDINGS[]  = {{NULL, "text",   SESSION_COLUMN_DISPLAY_NAME},
                                                                           {NULL, "pixbuf", SESSION_COLUMN_IMAGE},
                                                                           {NULL, NULL,     -1}};
@@ -177,7 +327,27 @@ static const ModelPropertyBinding USER_TEMPLATE_DEFAULT_BINDINGS[]     = {{NULL,
 
 void load_settings(void)
 {
+    if(load_config_snapshot())
+    {
+        if(config.greeter.themes_bundle)
+            load_themes_bundle();
+        return;
+    }
+
     g_message("Reading configuration: %s", CONFIG_FILE);
+    readahead_note_file(CONFIG_FILE);
+
+    snapshot_data.files = g_variant_builder_new(G_VARIANT_TYPE("a(stxx)"));
+    snapshot_data.files_set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    snapshot_data.gtk_settings = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    snapshot_data.allowed = TRUE;
+
+    /* Files that can change default values of GtkSettings */
+    gchar* user_gtk_settings = g_build_filename(g_get_user_config_dir(), "gtk-3.0", "settings.ini", NULL);
+    add_consulted_file(CONFIG_FILE);
+    add_consulted_file("/etc/gtk-3.0/settings.ini");
+    add_consulted_file(user_gtk_settings);
+    g_free(user_gtk_settings);
 
     GError* error = NULL;
     GKeyFile* cfg = g_key_file_new();
@@ -195,10 +365,23 @@ void load_settings(void)
     config.greeter.show_language_selector     = read_value_bool    (cfg, SECTION, "show-language-selector", TRUE);
     config.greeter.show_session_icon          = read_value_bool    (cfg, SECTION, "show-session-icon",      FALSE);
     config.greeter.allow_password_toggle      = read_value_bool    (cfg, SECTION, "allow-password-toggle",  FALSE);
+    config.greeter.recent_users_limit         = read_value_int     (cfg, SECTION, "recent-users-limit",     0);
+    config.greeter.themes_bundle              = read_value_bool    (cfg, SECTION, "themes-bundle",          TRUE);
+    config.greeter.readahead                  = read_value_bool    (cfg, SECTION, "readahead",              FALSE);
+    config.greeter.idle_timeout               = read_value_int     (cfg, SECTION, "idle-timeout",           0);
+    config.greeter.screenshot_format          = read_value_str     (cfg, SECTION, "screenshot-format",      "png");
+    config.greeter.screenshot_compression     = read_value_int     (cfg, SECTION, "screenshot-compression", 6);
+    config.greeter.watchdog_threshold         = read_value_int     (cfg, SECTION, "watchdog-threshold",     0);
+    config.greeter.watchdog_backtrace         = read_value_bool    (cfg, SECTION, "watchdog-backtrace",     FALSE);
+
+    if(config.greeter.themes_bundle)
+        load_themes_bundle();
 
     SECTION = "appearance";
     config.appearance.themes_stack            = NULL;
     config.appearance.ui_file                 = "themes/default/greeter.ui";
+    config.appearance.messagebox_ui_file      = NULL;
+    config.appearance.onboard_ui_file         = NULL;
     config.appearance.background              = NULL;
     config.appearance.user_background         = TRUE;
     config.appearance.x_background            = FALSE;
@@ -296,8 +479,12 @@ void load_settings(void)
 
     SECTION = "layout";
     config.layout.enabled                     = read_value_bool    (cfg, SECTION, "enabled", TRUE);
+    config.layout.backend                     = read_value_enum    (cfg, SECTION, "backend",
+                                                                    LAYOUT_BACKEND_STRINGS, LAYOUT_BACKEND_XKLAVIER);
 
     g_key_file_free(cfg);
+
+    save_config_snapshot();
 }
 
 void read_state(void)
@@ -309,6 +496,7 @@ void read_state(void)
 
     g_mkdir_with_parents(state_dir, 0775);
     state_data.path = g_build_filename(state_dir, "state", NULL);
+    readahead_note_file(state_data.path);
     state_data.config = g_key_file_new();
     g_key_file_load_from_file(state_data.config, state_data.path, G_KEY_FILE_NONE, &error);
     if(error && !g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
@@ -317,6 +505,18 @@ void read_state(void)
     g_free(state_dir);
 }
 
+void freeze_state(void)
+{
+    state_data.freeze_count++;
+}
+
+void thaw_state(void)
+{
+    g_return_if_fail(state_data.freeze_count > 0);
+    if(--state_data.freeze_count == 0 && state_data.changed)
+        save_state();
+}
+
 gchar* get_state_value_str(const gchar* section,
                            const gchar* key)
 {
@@ -328,7 +528,7 @@ void set_state_value_str(const gchar* section,
                          const gchar* value)
 {
     g_key_file_set_value(state_data.config, section, key, value);
-    save_key_file(state_data.config, state_data.path);
+    save_state();
 }
 
 gint get_state_value_int(const gchar* section,
@@ -343,40 +543,104 @@ void set_state_value_int(const gchar* section,
                          gint value)
 {
     g_key_file_set_integer(state_data.config, section, key, value);
-    save_key_file(state_data.config, state_data.path);
+    save_state();
 }
 
-void apply_gtk_theme(GtkSettings* settings,
-                     const gchar* gtk_theme)
+gchar** get_state_value_str_list(const gchar* section,
+                                 const gchar* key)
 {
-    GdkScreen* screen = gdk_screen_get_default();
+    return g_key_file_get_string_list(state_data.config, section, key, NULL, NULL);
+}
 
-    for(GSList* item = greeter.state.theming.style_providers; item != NULL; item = item->next)
+void set_state_value_str_list(const gchar* section,
+                              const gchar* key,
+                              const gchar* const* value)
+{
+    g_key_file_set_string_list(state_data.config, section, key, value, g_strv_length((gchar**)value));
+    save_state();
+}
+
+gchar* get_bundled_path(const gchar* path)
+{
+    if(!themes_bundle || !path || !g_str_has_prefix(path, GREETER_DATA_DIR))
+        return NULL;
+    const gchar* relative_path = path + strlen(GREETER_DATA_DIR);
+    if(relative_path[0] != G_DIR_SEPARATOR || strstr(relative_path, "/../"))
+        return NULL;
+
+    gchar* bundled_path = g_strconcat(THEMES_BUNDLE_PREFIX, relative_path, NULL);
+    gsize size = 0;
+    GStatBuf st;
+    /* One stat() without reading: installed file is used if it was removed or changed after bundle was built */
+    if(!g_resource_get_info(themes_bundle, bundled_path, G_RESOURCE_LOOKUP_FLAGS_NONE, &size, NULL, NULL) ||
+       g_stat(path, &st) != 0 || (gsize)st.st_size != size || (gint64)st.st_mtime > themes_bundle_mtime)
+        g_clear_pointer(&bundled_path, g_free);
+    return bundled_path;
+}
+
+GBytes* read_data_file(const gchar* path,
+                       GError** error)
+{
+    gchar* bundled_path = get_bundled_path(path);
+    readahead_note_file(bundled_path ? NULL : path);
+    if(bundled_path)
     {
-        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(item->data));
-        g_object_unref(item->data);
+        /* Data points directly to mapped bundle */
+        GBytes* data = g_resource_lookup_data(themes_bundle, bundled_path, G_RESOURCE_LOOKUP_FLAGS_NONE, error);
+        g_free(bundled_path);
+        return data;
     }
-    g_slist_free(greeter.state.theming.style_providers);
-    greeter.state.theming.style_providers = NULL;
 
-    for(GSList* item = config.appearance.themes_stack; item != NULL; item = g_slist_next(item))
+    gchar* str;
+    gsize str_size;
+    if(!g_file_get_contents(path, &str, &str_size, error))
+        return NULL;
+    return g_bytes_new_take(str, str_size);
+}
+
+GdkPixbuf* read_data_pixbuf(const gchar* path,
+                            GError** error)
+{
+    gchar* bundled_path = get_bundled_path(path);
+    readahead_note_file(bundled_path ? NULL : path);
+    GdkPixbuf* pixbuf = bundled_path ? gdk_pixbuf_new_from_resource(bundled_path, error)
+                                     : gdk_pixbuf_new_from_file(path, error);
+    g_free(bundled_path);
+    return pixbuf;
+}
+
+gboolean data_file_exists(const gchar* path)
+{
+    gchar* bundled_path = get_bundled_path(path);
+    g_free(bundled_path);
+    return bundled_path != NULL || g_file_test(path, G_FILE_TEST_IS_REGULAR);
+}
+
+void apply_gtk_theme(GtkSettings* settings,
+                     const gchar* gtk_theme)
+{
+    WATCHDOG_OPERATION("apply_gtk_theme");
+    GdkScreen* screen = gdk_screen_get_default();
+    GSList* providers = get_style_variant(gtk_theme);
+
+    if(providers != greeter.state.theming.style_providers)
     {
-        LoadedGreeterConfig* theme = item->data;
-        gchar* fix_css_path_wo_ext = g_build_filename(theme->path, "gtk-themes-fixes", gtk_theme, NULL);
-        gchar* fix_css_path = g_strconcat(fix_css_path_wo_ext, ".css", NULL);
-        if(theme->css_path)
-            greeter.state.theming.style_providers = g_slist_prepend(greeter.state.theming.style_providers,
-                                                                    read_css_file(theme->css_path, screen));
-        if(g_file_test(fix_css_path, G_FILE_TEST_IS_REGULAR))
-            greeter.state.theming.style_providers = g_slist_prepend(greeter.state.theming.style_providers,
-                                                                    read_css_file(fix_css_path, screen));
-        g_free(fix_css_path);
-        g_free(fix_css_path_wo_ext);
+        for(GSList* item = greeter.state.theming.style_providers; item != NULL; item = item->next)
+            gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(item->data));
+        for(GSList* item = providers; item != NULL; item = item->next)
+            gtk_style_context_add_provider_for_screen(screen, GTK_STYLE_PROVIDER(item->data),
+                                                      GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+        greeter.state.theming.style_providers = providers;
     }
     g_object_set(settings, "gtk-theme-name", gtk_theme, NULL);
     greeter.state.theming.gtk_theme_applied = TRUE;
 }
 
+void preload_gtk_theme(const gchar* gtk_theme)
+{
+    get_style_variant(gtk_theme);
+}
+
 void apply_icon_theme(GtkSettings* settings,
                       const gchar* icon_theme)
 {
@@ -388,9 +652,17 @@ void apply_icon_theme(GtkSettings* settings,
  * Definitions: static
  * -------------------------------------------------------------------------- */
 
+static void save_state(void)
+{
+    state_data.changed = state_data.freeze_count > 0;
+    if(!state_data.changed)
+        save_key_file(state_data.config, state_data.path);
+}
+
 static void save_key_file(GKeyFile* key_file,
                           const gchar* path)
 {
+    WATCHDOG_OPERATION("save_key_file");
     gsize data_length = 0;
     gchar* data = g_key_file_to_data(key_file, &data_length, NULL);
 
@@ -457,6 +729,7 @@ static void read_appearance_section(GKeyFile* cfg,
                             _("Reading base theme failed: theme \"%s\" already loaded, stopped to prevent infinite recursion.\n\n"
                               "Current path: \"%s\"\n"
                               "first load: \"%s\""), base_theme_name, path, first_load_path);
+        snapshot_data.allowed = FALSE;
         g_free(base_theme_name);
         base_theme_name = NULL;
     }
@@ -467,7 +740,10 @@ static void read_appearance_section(GKeyFile* cfg,
         GError* error = NULL;
         GKeyFile* theme_cfg = g_key_file_new();
         gchar* theme_filename = g_build_filename(GREETER_DATA_DIR, "themes", base_theme_name, "theme.conf", NULL);
-        if(g_key_file_load_from_file(theme_cfg, theme_filename, G_KEY_FILE_NONE, &error))
+        add_consulted_file(theme_filename);
+        GBytes* theme_data = read_data_file(theme_filename, &error);
+        if(theme_data && g_key_file_load_from_data(theme_cfg, g_bytes_get_data(theme_data, NULL), g_bytes_get_size(theme_data),
+                                                   G_KEY_FILE_NONE, &error))
         {
             if(!loaded_themes)
                 loaded_themes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
@@ -481,7 +757,10 @@ static void read_appearance_section(GKeyFile* cfg,
         {
             g_warning("Failed to load theme: %s.", error->message);
             g_clear_error(&error);
+            snapshot_data.allowed = FALSE;
         }
+        if(theme_data)
+            g_bytes_unref(theme_data);
         g_free(theme_filename);
         g_key_file_free(theme_cfg);
         g_free(base_theme_name);
@@ -504,6 +783,10 @@ static void read_appearance_section(GKeyFile* cfg,
 
     config.appearance.themes_stack            = g_slist_prepend    (config.appearance.themes_stack, theme);
     config.appearance.ui_file                 = read_value_path    (cfg, SECTION, "ui-file", config.appearance.ui_file, path);
+    config.appearance.messagebox_ui_file      = read_value_path    (cfg, SECTION, "messagebox-ui-file",
+                                                                    config.appearance.messagebox_ui_file, path);
+    config.appearance.onboard_ui_file         = read_value_path    (cfg, SECTION, "onboard-ui-file",
+                                                                    config.appearance.onboard_ui_file, path);
     config.appearance.background              = read_value_path    (cfg, SECTION, "background", config.appearance.background, path);
     config.appearance.user_background         = read_value_bool    (cfg, SECTION, "user-background", config.appearance.user_background);
     config.appearance.x_background            = read_value_bool    (cfg, SECTION, "x-background", config.appearance.x_background);
@@ -575,7 +858,10 @@ static gboolean read_value_bool_gtk(GKeyFile* key_file,
     GError* error = NULL;
     gboolean value = g_key_file_get_boolean(key_file, section, key, &error);
     if(!error || apply_default)
+    {
         g_object_set(settings, property, error ? default_value : value, NULL);
+        snapshot_gtk_setting(property, g_variant_new_boolean(error ? default_value : value));
+    }
     g_object_get(settings, property, &value, NULL);
     g_clear_error(&error);
     return value;
@@ -617,7 +903,12 @@ static gchar* read_value_str_gtk(GKeyFile* key_file,
     GError* error = NULL;
     gchar* value = g_key_file_get_string(key_file, section, key, &error);
     if(!error || apply_default)
-        g_object_set(settings, property, error ? default_value : value, NULL);
+    {
+        const gchar* applied_value = error ? default_value : value;
+        g_object_set(settings, property, applied_value, NULL);
+        snapshot_gtk_setting(property, g_variant_new_maybe(G_VARIANT_TYPE_STRING,
+                                                           applied_value ? g_variant_new_string(applied_value) : NULL));
+    }
     g_object_get(settings, property, &value, NULL);
     g_clear_error(&error);
     return value;
@@ -750,7 +1041,10 @@ static gint read_value_dpi_gtk(GKeyFile* key_file,
     GError* error = NULL;
     gint value = g_key_file_get_integer(key_file, section, key, &error);
     if(!error)
+    {
         g_object_set(settings, property, 1024*value, NULL);
+        snapshot_gtk_setting(property, g_variant_new_int32(1024*value));
+    }
     g_object_get(settings, property, &value, NULL);
     g_clear_error(&error);
     return value/1024;
@@ -772,15 +1066,21 @@ static gchar* read_value_path(GKeyFile* key_file,
     return value;
 }
 
-static GtkStyleProvider* read_css_file(const gchar* path,
-                                       GdkScreen* screen)
+static GtkStyleProvider* read_css_file(const gchar* path)
 {
     g_message("Loading CSS file: %s", path);
     GError* error = NULL;
     GtkCssProvider* provider = gtk_css_provider_new();
-    gtk_style_context_add_provider_for_screen(screen, GTK_STYLE_PROVIDER(provider),
-                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    if(!gtk_css_provider_load_from_path(provider, path, &error))
+    /* Loading from GFile keeps relative url() working for bundled files */
+    gchar* bundled_path = get_bundled_path(path);
+    gchar* uri = bundled_path ? g_strconcat("resource://", bundled_path, NULL) : NULL;
+    readahead_note_file(bundled_path ? NULL : path);
+    GFile* file = uri ? g_file_new_for_uri(uri) : g_file_new_for_path(path);
+    gboolean loaded = gtk_css_provider_load_from_file(provider, file, &error);
+    g_object_unref(file);
+    g_free(uri);
+    g_free(bundled_path);
+    if(!loaded)
     {
         g_warning("Error loading CSS: %s", error->message);
         g_clear_error(&error);
@@ -788,6 +1088,34 @@ static GtkStyleProvider* read_css_file(const gchar* path,
     return GTK_STYLE_PROVIDER(provider);
 }
 
+/* Returns providers for all themes in stack in order of applying, parsed once per Gtk theme */
+static GSList* get_style_variant(const gchar* gtk_theme)
+{
+    if(!greeter.state.theming.style_variants)
+        greeter.state.theming.style_variants = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    const gchar* key = gtk_theme ? gtk_theme : "";
+    GSList* providers = NULL;
+    if(g_hash_table_lookup_extended(greeter.state.theming.style_variants, key, NULL, (gpointer*)&providers))
+        return providers;
+
+    for(GSList* item = config.appearance.themes_stack; item != NULL; item = g_slist_next(item))
+    {
+        LoadedGreeterConfig* theme = item->data;
+        gchar* fix_css_path_wo_ext = g_build_filename(theme->path, "gtk-themes-fixes", gtk_theme, NULL);
+        gchar* fix_css_path = g_strconcat(fix_css_path_wo_ext, ".css", NULL);
+        if(theme->css_path)
+            providers = g_slist_prepend(providers, read_css_file(theme->css_path));
+        if(gtk_theme && data_file_exists(fix_css_path))
+            providers = g_slist_prepend(providers, read_css_file(fix_css_path));
+        g_free(fix_css_path);
+        g_free(fix_css_path_wo_ext);
+    }
+    providers = g_slist_reverse(providers);
+    g_hash_table_insert(greeter.state.theming.style_variants, g_strdup(key), providers);
+    return providers;
+}
+
 /* TODO: move it to shares.c and mark "conf" chnages */
 static void read_templates(void)
 {
@@ -843,16 +1171,18 @@ static void read_templates(void)
 
     for(struct Template* template = templates; template->data != NULL; template++)
         if(template->ui_file)
+        {
             g_hash_table_insert(table, template->ui_file, NULL);
+            add_consulted_file(template->ui_file);
+        }
 
     g_hash_table_iter_init(&iter, table);
     while(g_hash_table_iter_next(&iter, (gpointer)&key, NULL))
         if(key)
         {
-            gchar* str;
-            gsize str_size;
-            if(g_file_get_contents(key, &str, &str_size, NULL))
-                g_hash_table_iter_replace(&iter, g_bytes_new_take(str, str_size));
+            GBytes* data = read_data_file(key, NULL);
+            if(data)
+                g_hash_table_iter_replace(&iter, data);
         }
     #endif
 
@@ -880,3 +1210,333 @@ static void read_templates(void)
     g_hash_table_unref(table);
     #endif
 }
+
+static void load_themes_bundle(void)
+{
+    if(themes_bundle)
+        return;
+
+    gchar* path = g_build_filename(GREETER_DATA_DIR, THEMES_BUNDLE_FILE, NULL);
+    GError* error = NULL;
+    /* File is mapped, not read */
+    themes_bundle = g_resource_load(path, &error);
+    if(themes_bundle)
+    {
+        GStatBuf st;
+        themes_bundle_mtime = g_stat(path, &st) == 0 ? (gint64)st.st_mtime : 0;
+        g_message("Using themes bundle: %s", path);
+        g_resources_register(themes_bundle);
+    }
+    else
+    {
+        if(!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning("Failed to load themes bundle: %s", error->message);
+        g_clear_error(&error);
+    }
+    g_free(path);
+}
+
+/* Bundled files are stored as installed files: bundle is used only while they are not modified */
+static void add_consulted_file(const gchar* path)
+{
+    if(!snapshot_data.files || !path)
+        return;
+
+    gchar* file_path = g_strdup(path);
+    if(g_hash_table_contains(snapshot_data.files_set, file_path))
+    {
+        g_free(file_path);
+        return;
+    }
+
+    GStatBuf st;
+    /* Missing file is stored too: snapshot becomes invalid when it is created */
+    if(g_stat(file_path, &st) != 0)
+        memset(&st, 0, sizeof(st));
+    g_variant_builder_add(snapshot_data.files, "(stxx)", file_path,
+                          (guint64)st.st_ino, (gint64)st.st_mtime, (gint64)st.st_size);
+    g_hash_table_add(snapshot_data.files_set, file_path);
+}
+
+static void snapshot_gtk_setting(const gchar* property,
+                                 GVariant* value)
+{
+    if(snapshot_data.gtk_settings)
+        g_variant_builder_add(snapshot_data.gtk_settings, "{sv}", property, value);
+    else
+        g_variant_unref(g_variant_ref_sink(value));
+}
+
+static gchar* get_config_snapshot_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), APP_NAME, CONFIG_SNAPSHOT_FILE, NULL);
+}
+
+static GVariant* snapshot_templates(void)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(msmaya(msi))"));
+
+    #if GTK_CHECK_VERSION(3, 10, 0)
+    typeof(config.appearance.templates.session)* templates[] = {&config.appearance.templates.session,
+                                                               &config.appearance.templates.language,
+                                                               &config.appearance.templates.user};
+    for(guint i = 0; i < G_N_ELEMENTS(templates); ++i)
+    {
+        GVariantBuilder bindings;
+        g_variant_builder_init(&bindings, G_VARIANT_TYPE("a(msi)"));
+        for(GSList* item = templates[i]->bindings; item != NULL; item = item->next)
+        {
+            const ModelPropertyBinding* bind = item->data;
+            g_variant_builder_add(&bindings, "(msi)", bind->widget, bind->prop, bind->column);
+        }
+        GVariant* data = templates[i]->data ? g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, templates[i]->data, TRUE) : NULL;
+        g_variant_builder_add(&builder, "(ms@may@a(msi))", templates[i]->ui_file,
+                              g_variant_new_maybe(G_VARIANT_TYPE_BYTESTRING, data),
+                              g_variant_builder_end(&bindings));
+    }
+    #endif
+    return g_variant_builder_end(&builder);
+}
+
+static void restore_templates(GVariant* value)
+{
+    #if GTK_CHECK_VERSION(3, 10, 0)
+    typeof(config.appearance.templates.session)* templates[] = {&config.appearance.templates.session,
+                                                               &config.appearance.templates.language,
+                                                               &config.appearance.templates.user};
+    for(guint i = 0; i < G_N_ELEMENTS(templates) && i < g_variant_n_children(value); ++i)
+    {
+        GVariant* data = NULL;
+        GVariantIter* bindings = NULL;
+        g_variant_get_child(value, i, "(ms@maya(msi))", &templates[i]->ui_file, &data, &bindings);
+
+        GVariant* bytes = g_variant_get_maybe(data);
+        /* Data is not copied: references snapshot buffer */
+        templates[i]->data = bytes ? g_variant_get_data_as_bytes(bytes) : NULL;
+        if(bytes)
+            g_variant_unref(bytes);
+        g_variant_unref(data);
+
+        templates[i]->bindings = NULL;
+        ModelPropertyBinding bind;
+        while(g_variant_iter_next(bindings, "(msi)", &bind.widget, &bind.prop, &bind.column))
+            templates[i]->bindings = g_slist_append(templates[i]->bindings, g_memdup(&bind, sizeof(ModelPropertyBinding)));
+        g_variant_iter_free(bindings);
+    }
+    #else
+    /* Without composite templates default bindings are always used */
+    read_templates();
+    #endif
+}
+
+static void save_config_snapshot(void)
+{
+    GVariant* files = g_variant_builder_end(snapshot_data.files);
+    GVariant* gtk_settings = g_variant_builder_end(snapshot_data.gtk_settings);
+    g_variant_ref_sink(files);
+    g_variant_ref_sink(gtk_settings);
+    g_variant_builder_unref(snapshot_data.files);
+    g_variant_builder_unref(snapshot_data.gtk_settings);
+    g_hash_table_unref(snapshot_data.files_set);
+    snapshot_data.files = NULL;
+    snapshot_data.gtk_settings = NULL;
+    snapshot_data.files_set = NULL;
+
+    gchar* path = get_config_snapshot_path();
+    if(!snapshot_data.allowed)
+    {
+        g_unlink(path);
+        g_variant_unref(files);
+        g_variant_unref(gtk_settings);
+        g_free(path);
+        return;
+    }
+
+    GVariantBuilder values;
+    g_variant_builder_init(&values, G_VARIANT_TYPE("a{sv}"));
+    for(const SnapshotField* field = SNAPSHOT_FIELDS; field->key; ++field)
+    {
+        gpointer p = G_STRUCT_MEMBER_P(&config, field->offset);
+        GVariant* value = NULL;
+        switch(field->type)
+        {
+            case SNAPSHOT_FIELD_BOOL:
+                value = g_variant_new_boolean(*(gboolean*)p);
+                break;
+            case SNAPSHOT_FIELD_INT:
+                value = g_variant_new_int32(*(gint*)p);
+                break;
+            case SNAPSHOT_FIELD_STR:
+                value = g_variant_new_maybe(G_VARIANT_TYPE_STRING, *(gchar**)p ? g_variant_new_string(*(gchar**)p) : NULL);
+                break;
+            case SNAPSHOT_FIELD_STRV:
+                value = g_variant_new_strv(*(const gchar* const**)p, *(gchar***)p ? -1 : 0);
+                break;
+            case SNAPSHOT_FIELD_POSITION:
+            {
+                const WindowPosition* wp = p;
+                value = g_variant_new("(iibiiibi)", wp->x.value, wp->x.sign, wp->x.percentage, wp->x.anchor,
+                                                     wp->y.value, wp->y.sign, wp->y.percentage, wp->y.anchor);
+                break;
+            }
+        }
+        g_variant_builder_add(&values, "{sv}", field->key, value);
+    }
+
+    GVariantBuilder themes;
+    g_variant_builder_init(&themes, G_VARIANT_TYPE("a(sms)"));
+    for(GSList* item = config.appearance.themes_stack; item != NULL; item = item->next)
+    {
+        const LoadedGreeterConfig* theme = item->data;
+        g_variant_builder_add(&themes, "(sms)", theme->path, theme->css_path);
+    }
+    g_variant_builder_add(&values, "{sv}", "appearance.themes-stack", g_variant_builder_end(&themes));
+    g_variant_builder_add(&values, "{sv}", "appearance.templates", snapshot_templates());
+    g_variant_builder_add(&values, "{sv}", "gtk-settings", gtk_settings);
+
+    GVariant* snapshot = g_variant_ref_sink(g_variant_new("(su@a(stxx)@a{sv})", PACKAGE_VERSION, CONFIG_SNAPSHOT_VERSION,
+                                                files, g_variant_builder_end(&values)));
+
+    gchar* dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0775);
+    GError* error = NULL;
+    if(!g_file_set_contents(path, g_variant_get_data(snapshot), g_variant_get_size(snapshot), &error))
+    {
+        g_warning("Failed to save configuration snapshot: %s", error->message);
+        g_clear_error(&error);
+    }
+    g_free(dir);
+    g_variant_unref(snapshot);
+    g_variant_unref(files);
+    g_variant_unref(gtk_settings);
+    g_free(path);
+}
+
+static gboolean is_config_snapshot_valid(GVariant* snapshot)
+{
+    const gchar* version = NULL;
+    guint32 format = 0;
+    GVariantIter* files = NULL;
+    g_variant_get(snapshot, "(&sua(stxx)@a{sv})", &version, &format, &files, NULL);
+
+    gboolean valid = g_strcmp0(version, PACKAGE_VERSION) == 0 && format == CONFIG_SNAPSHOT_VERSION;
+    const gchar* path;
+    guint64 inode;
+    gint64 mtime, size;
+    while(valid && g_variant_iter_next(files, "(&stxx)", &path, &inode, &mtime, &size))
+    {
+        GStatBuf st;
+        if(g_stat(path, &st) != 0)
+            memset(&st, 0, sizeof(st));
+        valid = (guint64)st.st_ino == inode && (gint64)st.st_mtime == mtime && (gint64)st.st_size == size;
+        if(!valid)
+            g_debug("Configuration snapshot is outdated: %s", path);
+    }
+    g_variant_iter_free(files);
+    return valid;
+}
+
+static gboolean load_config_snapshot(void)
+{
+    gchar* path = get_config_snapshot_path();
+    readahead_note_file(path);
+    gchar* contents = NULL;
+    gsize length = 0;
+    gboolean loaded = g_file_get_contents(path, &contents, &length, NULL);
+    g_free(path);
+    if(!loaded)
+        return FALSE;
+
+    GBytes* bytes = g_bytes_new_take(contents, length);
+    GVariant* snapshot = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(CONFIG_SNAPSHOT_TYPE), bytes, FALSE));
+    g_bytes_unref(bytes);
+    /* Do not trust damaged files */
+    if(!g_variant_is_normal_form(snapshot) || !is_config_snapshot_valid(snapshot))
+    {
+        g_variant_unref(snapshot);
+        return FALSE;
+    }
+
+    g_message("Reading configuration snapshot");
+
+    GVariant* values_variant = g_variant_get_child_value(snapshot, 3);
+    GVariantDict values;
+    g_variant_dict_init(&values, values_variant);
+
+    for(const SnapshotField* field = SNAPSHOT_FIELDS; field->key; ++field)
+    {
+        gpointer p = G_STRUCT_MEMBER_P(&config, field->offset);
+        switch(field->type)
+        {
+            case SNAPSHOT_FIELD_BOOL:
+                g_variant_dict_lookup(&values, field->key, "b", (gboolean*)p);
+                break;
+            case SNAPSHOT_FIELD_INT:
+                g_variant_dict_lookup(&values, field->key, "i", (gint*)p);
+                break;
+            case SNAPSHOT_FIELD_STR:
+                g_variant_dict_lookup(&values, field->key, "ms", (gchar**)p);
+                break;
+            case SNAPSHOT_FIELD_STRV:
+                if(g_variant_dict_lookup(&values, field->key, "^as", (gchar***)p) && !**(gchar***)p)
+                    g_clear_pointer((gchar***)p, g_strfreev);
+                break;
+            case SNAPSHOT_FIELD_POSITION:
+            {
+                WindowPosition* wp = p;
+                g_variant_dict_lookup(&values, field->key, "(iibiiibi)",
+                                      &wp->x.value, &wp->x.sign, &wp->x.percentage, &wp->x.anchor,
+                                      &wp->y.value, &wp->y.sign, &wp->y.percentage, &wp->y.anchor);
+                break;
+            }
+        }
+    }
+
+    GVariantIter* iter = NULL;
+    config.appearance.themes_stack = NULL;
+    if(g_variant_dict_lookup(&values, "appearance.themes-stack", "a(sms)", &iter))
+    {
+        LoadedGreeterConfig theme;
+        while(g_variant_iter_next(iter, "(sms)", &theme.path, &theme.css_path))
+            config.appearance.themes_stack = g_slist_append(config.appearance.themes_stack,
+                                                            g_memdup(&theme, sizeof(LoadedGreeterConfig)));
+        g_variant_iter_free(iter);
+    }
+
+    GVariant* templates = g_variant_dict_lookup_value(&values, "appearance.templates", NULL);
+    if(templates)
+    {
+        restore_templates(templates);
+        g_variant_unref(templates);
+    }
+
+    /* Values that were applied to GtkSettings while reading configuration */
+    GtkSettings* settings = gtk_settings_get_default();
+    const gchar* property;
+    GVariant* value;
+    if(g_variant_dict_lookup(&values, "gtk-settings", "a{sv}", &iter))
+    {
+        while(g_variant_iter_next(iter, "{&sv}", &property, &value))
+        {
+            if(g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN))
+                g_object_set(settings, property, g_variant_get_boolean(value), NULL);
+            else if(g_variant_is_of_type(value, G_VARIANT_TYPE_INT32))
+                g_object_set(settings, property, g_variant_get_int32(value), NULL);
+            else
+            {
+                gchar* str = NULL;
+                g_variant_get(value, "ms", &str);
+                g_object_set(settings, property, str, NULL);
+                g_free(str);
+            }
+            g_variant_unref(value);
+        }
+        g_variant_iter_free(iter);
+    }
+
+    g_variant_dict_clear(&values);
+    g_variant_unref(values_variant);
+    g_variant_unref(snapshot);
+    return TRUE;
+}
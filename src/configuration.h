@@ -47,6 +47,14 @@ typedef enum
     PANEL_POS_BOTTOM
 } PanelPosition;
 
+typedef enum
+{
+    /* libxklavier on its own display connection */
+    LAYOUT_BACKEND_XKLAVIER,
+    /* XKB on GDK display connection */
+    LAYOUT_BACKEND_XKB
+} LayoutBackend;
+
 typedef enum
 {
     USER_IMAGE_FIT_NONE,
@@ -71,12 +79,29 @@ typedef struct
         gboolean        show_session_icon;
         guint32         double_escape_time;
         gboolean        allow_password_toggle;
+        /* Show only N most recently logged in users, 0 - show all */
+        gint            recent_users_limit;
+        /* Read theme files from compiled themes.gresource if it is installed */
+        gboolean        themes_bundle;
+        /* Record files read at startup and read them ahead on next start */
+        gboolean        readahead;
+        /* Enter low-power mode after N seconds without input, 0 - only when screen saver is active */
+        gint            idle_timeout;
+        /* Any format writable by gdk-pixbuf, compression level (0-9) is used only for png */
+        gchar*          screenshot_format;
+        gint            screenshot_compression;
+        /* Report main loop stalls longer than N ms, 0 - disabled */
+        gint            watchdog_threshold;
+        gboolean        watchdog_backtrace;
     } greeter;
 
     struct
     {
         GSList*         themes_stack;
         gchar*          ui_file;
+        /* Rarely used parts of UI, built on first use if ui_file does not contain them */
+        gchar*          messagebox_ui_file;
+        gchar*          onboard_ui_file;
         gchar*          gtk_theme;
         gchar*          icon_theme;
         gchar*          background;
@@ -182,6 +207,7 @@ typedef struct
     {
         gboolean        enabled;
         gboolean        enabled_for_one;
+        LayoutBackend   backend;
     } layout;
 } GreeterConfig;
 
@@ -193,6 +219,9 @@ extern GreeterConfig config;
 
 void load_settings               (void);
 void read_state                  (void);
+/* Postpone writing of state file until thaw_state() */
+void freeze_state                (void);
+void thaw_state                  (void);
 
 gchar* get_state_value_str       (const gchar* section,
                                   const gchar* key);
@@ -204,10 +233,25 @@ gint get_state_value_int         (const gchar* section,
 void set_state_value_int         (const gchar* section,
                                   const gchar* key,
                                   gint value);
+gchar** get_state_value_str_list (const gchar* section,
+                                  const gchar* key);
+void set_state_value_str_list    (const gchar* section,
+                                  const gchar* key,
+                                  const gchar* const* value);
+
+/* Files from GREETER_DATA_DIR are read from themes bundle if it contains them */
+gchar* get_bundled_path          (const gchar* path);
+GBytes* read_data_file           (const gchar* path,
+                                  GError** error);
+GdkPixbuf* read_data_pixbuf      (const gchar* path,
+                                  GError** error);
+gboolean data_file_exists        (const gchar* path);
 
 /* Apply Gtk theme and load all CSS fixes for it from greeter themes */
 void apply_gtk_theme             (GtkSettings* settings,
                                   const gchar* gtk_theme);
+/* Parse CSS files used with Gtk theme without applying them */
+void preload_gtk_theme           (const gchar* gtk_theme);
 void apply_icon_theme            (GtkSettings* settings,
                                   const gchar* gtk_theme);
 
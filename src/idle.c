@@ -0,0 +1,211 @@
+/* idle.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#ifdef HAVE_XSS
+    #include <X11/extensions/scrnsaver.h>
+#endif
+
+#include "shares.h"
+#include "configuration.h"
+#include "indicator_clock.h"
+#include "watchdog.h"
+#include "idle.h"
+
+/* Static variables */
+
+static struct
+{
+    gboolean    idle;
+    /* Monotonic time of last input event */
+    gint64      last_input;
+    guint       timeout_id;
+    /* Main loop wakeups counted in idle mode */
+    guint       wakeups;
+    gint64      idle_since;
+    GPollFunc   default_poll;
+    gboolean    cursor_blink;
+    #ifdef HAVE_XSS
+    gint        xss_event_base;
+    #endif
+} idle_data;
+
+/* Static functions */
+
+static void enter_idle_mode                     (const gchar* reason);
+static void leave_idle_mode                     (void);
+static void schedule_idle_timeout               (guint seconds);
+static gboolean on_idle_timeout                 (gpointer data);
+static gint idle_poll                           (GPollFD* fds,
+                                                 guint nfds,
+                                                 gint timeout);
+static GdkFilterReturn idle_event_filter        (GdkXEvent* xev,
+                                                 GdkEvent* event,
+                                                 gpointer data);
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void init_idle_mode(void)
+{
+    gboolean enabled = config.greeter.idle_timeout > 0;
+
+    #ifdef HAVE_XSS
+    Display* display = gdk_x11_get_default_xdisplay();
+    gint error_base;
+    if(XScreenSaverQueryExtension(display, &idle_data.xss_event_base, &error_base))
+    {
+        XScreenSaverSelectInput(display, gdk_x11_get_default_root_xwindow(), ScreenSaverNotifyMask);
+        enabled = TRUE;
+    }
+    else
+        g_message("Idle mode: XScreenSaver extension is not available");
+    #endif
+
+    if(!enabled)
+        return;
+
+    idle_data.last_input = g_get_monotonic_time();
+    idle_data.default_poll = g_main_context_get_poll_func(NULL);
+    g_main_context_set_poll_func(NULL, idle_poll);
+    gdk_window_add_filter(NULL, idle_event_filter, NULL);
+    if(config.greeter.idle_timeout > 0)
+        schedule_idle_timeout(config.greeter.idle_timeout);
+}
+
+gboolean is_idle(void)
+{
+    return idle_data.idle;
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static void enter_idle_mode(const gchar* reason)
+{
+    if(idle_data.idle)
+        return;
+
+    g_message("Idle mode: entering (%s)", reason);
+    idle_data.idle = TRUE;
+    idle_data.wakeups = 0;
+    idle_data.idle_since = g_get_monotonic_time();
+    if(idle_data.timeout_id)
+    {
+        g_source_remove(idle_data.timeout_id);
+        idle_data.timeout_id = 0;
+    }
+
+    clock_suspend();
+    watchdog_pause();
+    release_window_background();
+
+    GtkSettings* settings = gtk_settings_get_default();
+    g_object_get(settings, "gtk-cursor-blink", &idle_data.cursor_blink, NULL);
+    if(idle_data.cursor_blink)
+        g_object_set(settings, "gtk-cursor-blink", FALSE, NULL);
+}
+
+static void leave_idle_mode(void)
+{
+    if(!idle_data.idle)
+        return;
+
+    const gdouble minutes = (g_get_monotonic_time() - idle_data.idle_since)/(60.0*G_USEC_PER_SEC);
+    g_message("Idle mode: leaving after %.1f minutes, %u wakeups (%.2f per minute)",
+              minutes, idle_data.wakeups, minutes > 0 ? idle_data.wakeups/minutes : 0.0);
+    idle_data.idle = FALSE;
+
+    if(idle_data.cursor_blink)
+        g_object_set(gtk_settings_get_default(), "gtk-cursor-blink", TRUE, NULL);
+    clock_resume();
+    watchdog_resume();
+
+    if(config.greeter.idle_timeout > 0)
+        schedule_idle_timeout(config.greeter.idle_timeout);
+}
+
+static void schedule_idle_timeout(guint seconds)
+{
+    if(idle_data.timeout_id)
+        g_source_remove(idle_data.timeout_id);
+    idle_data.timeout_id = g_timeout_add_seconds(seconds, on_idle_timeout, NULL);
+}
+
+/* Input events do not reset timer, time of last input is checked when it fires */
+static gboolean on_idle_timeout(gpointer data)
+{
+    idle_data.timeout_id = 0;
+    const gint64 idle_time = (g_get_monotonic_time() - idle_data.last_input)/G_USEC_PER_SEC;
+    if(idle_time >= config.greeter.idle_timeout)
+        enter_idle_mode("timeout");
+    else
+        schedule_idle_timeout(config.greeter.idle_timeout - idle_time);
+    return G_SOURCE_REMOVE;
+}
+
+static gint idle_poll(GPollFD* fds,
+                      guint nfds,
+                      gint timeout)
+{
+    gint result = idle_data.default_poll(fds, nfds, timeout);
+    if(idle_data.idle)
+        idle_data.wakeups++;
+    return result;
+}
+
+static GdkFilterReturn idle_event_filter(GdkXEvent* xev,
+                                         GdkEvent* event,
+                                         gpointer data)
+{
+    const XEvent* xevent = (const XEvent*)xev;
+    switch(xevent->type)
+    {
+        case KeyPress:
+        case KeyRelease:
+        case ButtonPress:
+        case ButtonRelease:
+        case MotionNotify:
+        /* XInput2 events */
+        case GenericEvent:
+            idle_data.last_input = g_get_monotonic_time();
+            leave_idle_mode();
+            break;
+        default:
+            #ifdef HAVE_XSS
+            if(xevent->type == idle_data.xss_event_base + ScreenSaverNotify)
+            {
+                const XScreenSaverNotifyEvent* ss_event = (const XScreenSaverNotifyEvent*)xevent;
+                if(ss_event->state == ScreenSaverOn)
+                    enter_idle_mode("screen saver");
+                else if(ss_event->state == ScreenSaverOff)
+                    leave_idle_mode();
+            }
+            #endif
+            break;
+    }
+    return GDK_FILTER_CONTINUE;
+}
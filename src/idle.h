@@ -0,0 +1,33 @@
+/* idle.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _IDLE_H_INCLUDED_
+#define _IDLE_H_INCLUDED_
+
+#include <glib.h>
+
+/* Functions */
+
+/* Enter low-power mode after idle-timeout seconds without input or when screen saver
+   blanks the display. Must be called after main window is shown */
+void init_idle_mode                    (void);
+gboolean is_idle                       (void);
+
+#endif // _IDLE_H_INCLUDED_
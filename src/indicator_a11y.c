@@ -26,12 +26,15 @@
 #include "shares.h"
 #include "configuration.h"
 #include "indicator_a11y.h"
+#include "probes.h"
+#include "watchdog.h"
 
 /* Types */
 
 typedef struct _OnscreenKeyboardInfo
 {
-    gboolean (*check) (void);
+    /* Program to search in PATH, NULL if keyboard can not be used */
+    const gchar* (*get_program) (void);
     void (*open) (void);
     void (*close) (void);
     void (*kill) (void);
@@ -48,22 +51,54 @@ void on_a11y_contrast_toggled                   (GtkWidget* widget,
 void on_a11y_osk_toggled                        (GtkWidget* widget,
                                                  gpointer data);
 
+/* Static constants */
+
+/* Give up restarting "onboard" after this number of failed starts in a row */
+static const guint ONBOARD_MAX_FAILURES        = 3;
+/* Seconds */
+static const guint ONBOARD_RESTART_DELAY       = 1;
+/* Seconds, onboard that exited earlier after embedding is counted as failed start */
+static const guint ONBOARD_MIN_UPTIME          = 10;
+
 /* Static functions */
 
 static gint get_increment                       (gint value,
                                                  gint increment,
                                                  gboolean is_percent);
-static gboolean program_is_available            (const gchar* name);
+static gboolean preload_contrast_theme          (gpointer dummy);
+static void apply_a11y_profile                  (gboolean font,
+                                                 gboolean dpi,
+                                                 gboolean contrast);
+
+static void on_osk_program_probed               (const gchar* name,
+                                                 const gchar* path,
+                                                 OnscreenKeyboardInfo* keyboard);
 
-static gboolean osk_check_custom                (void);
+static const gchar* osk_get_program_custom      (void);
 static void osk_open_custom                     (void);
 static void osk_close_custom                    (void);
 static void osk_kill_custom                     (void);
+static void on_custom_osk_exited                (GPid pid,
+                                                 gint status,
+                                                 gpointer data);
 
-static gboolean osk_check_onboard               (void);
+static const gchar* osk_get_program_onboard     (void);
 static void osk_open_onboard                    (void);
 static void osk_close_onboard                   (void);
 static void osk_kill_onboard                    (void);
+static gboolean spawn_onboard                   (void);
+static gboolean start_onboard                   (gpointer dummy);
+static void embed_onboard                       (Window xid);
+static void stop_onboard_restarts               (void);
+static gboolean on_onboard_output               (GIOChannel* channel,
+                                                 GIOCondition condition,
+                                                 gpointer data);
+static void on_onboard_exited                   (GPid pid,
+                                                 gint status,
+                                                 gpointer data);
+static void on_killed_onboard_exited            (GPid pid,
+                                                 gint status,
+                                                 gpointer data);
 
 /* Static variables */
 
@@ -85,7 +120,7 @@ keyboard_command =
 {
     .info =
     {
-        .check = osk_check_custom,
+        .get_program = osk_get_program_custom,
         .open = osk_open_custom,
         .close = osk_close_custom,
         .kill = osk_kill_custom
@@ -96,13 +131,23 @@ static struct
 {
     OnscreenKeyboardInfo info;
     GPid pid;
+    /* Created when onboard reports its XID, hidden with onboard_layout when keyboard is closed */
     GtkSocket* socket;
+    guint output_watch;
+    guint child_watch;
+    guint restart_id;
+    /* Monotonic time of embedding, to check uptime */
+    gint64 embed_time;
+    /* Starts that ended before onboard was embedded or before ONBOARD_MIN_UPTIME, in a row */
+    guint failures;
+    /* Greeter is exiting, do not restart onboard */
+    gboolean stopping;
 }
 keyboard_onboard =
 {
     .info =
     {
-        .check = osk_check_onboard,
+        .get_program = osk_get_program_onboard,
         .open = osk_open_onboard,
         .close = osk_close_onboard,
         .kill = osk_kill_onboard
@@ -119,10 +164,13 @@ void init_a11y_indicator(void)
     {
         if(config.a11y.osk.enabled)
         {
-            if(config.a11y.osk.use_onboard && keyboard_onboard.info.check())
-                a11y.onscreen_keyboard = &keyboard_onboard.info;
-            else if(keyboard_command.info.check())
-                a11y.onscreen_keyboard = &keyboard_command.info;
+            /* Custom command is used if onboard can not be used, or it is not found by on_osk_program_probed() */
+            OnscreenKeyboardInfo* keyboard = config.a11y.osk.use_onboard && keyboard_onboard.info.get_program()
+                                             ? &keyboard_onboard.info : &keyboard_command.info;
+            const gchar* program = keyboard->get_program();
+            /* Menu item is shown when program is found, see on_osk_program_probed() */
+            if(program)
+                probe_program(program, (ProgramProbeCallback)on_osk_program_probed, keyboard);
             else
             {
                 g_warning("a11y: no virtual keyboard found");
@@ -141,19 +189,18 @@ void init_a11y_indicator(void)
     }
 
     gtk_widget_set_visible(greeter.ui.a11y.widget, config.a11y.enabled);
-    gtk_widget_set_visible(greeter.ui.a11y.osk_box, config.a11y.enabled && config.a11y.osk.enabled);
+    gtk_widget_set_visible(greeter.ui.a11y.osk_box, FALSE);
     gtk_widget_set_visible(greeter.ui.a11y.font_box, config.a11y.enabled && config.a11y.font.enabled);
     gtk_widget_set_visible(greeter.ui.a11y.dpi_box, config.a11y.enabled && config.a11y.dpi.enabled);
     gtk_widget_set_visible(greeter.ui.a11y.contrast_box, config.a11y.enabled && config.a11y.contrast.enabled);
 
     if(config.a11y.enabled)
     {
-        if(config.a11y.contrast.enabled && get_state_value_int("a11y", "contrast"))
-            a11y_toggle_contrast();
-        if(config.a11y.font.enabled && get_state_value_int("a11y", "font"))
-            a11y_toggle_font();
-        if(config.a11y.dpi.enabled && get_state_value_int("a11y", "dpi"))
-            a11y_toggle_dpi();
+        apply_a11y_profile(config.a11y.font.enabled && get_state_value_int("a11y", "font"),
+                           config.a11y.dpi.enabled && get_state_value_int("a11y", "dpi"),
+                           config.a11y.contrast.enabled && get_state_value_int("a11y", "contrast"));
+        if(config.a11y.contrast.enabled)
+            g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)preload_contrast_theme, NULL, NULL);
     }
 }
 
@@ -170,7 +217,6 @@ void a11y_toggle_osk()
     g_return_if_fail(a11y.onscreen_keyboard != NULL);
 
     a11y.state.osk = !a11y.state.osk;
-    gtk_widget_hide(greeter.ui.main_content);
     if(greeter.ui.a11y.osk_widget)
         set_widget_toggled(greeter.ui.a11y.osk_widget, a11y.state.osk, G_CALLBACK(on_a11y_osk_toggled));
     if(a11y.state.osk)
@@ -178,86 +224,51 @@ void a11y_toggle_osk()
     else
         a11y.onscreen_keyboard->close();
     update_main_window_layout();
-    gtk_widget_show(greeter.ui.main_content);
 }
 
-void a11y_toggle_font(void)
+/* Returns configured font name with size increased by a11y.font.increment */
+gchar* a11y_get_font_name(gboolean enlarged)
 {
-    g_return_if_fail(config.a11y.font.enabled);
-
-    a11y.state.font = !a11y.state.font;
-    if(greeter.ui.a11y.font_widget)
-        set_widget_toggled(greeter.ui.a11y.font_widget, a11y.state.font, G_CALLBACK(on_a11y_font_toggled));
+    if(!enlarged || !config.appearance.font)
+        return g_strdup(config.appearance.font);
 
-    GtkSettings* settings = gtk_settings_get_default();
-    if(a11y.state.font)
+    gchar* font_name = NULL;
+    gchar** tokens = g_strsplit(config.appearance.font, " ", -1);
+    guint length = g_strv_length(tokens);
+    if(length > 1)
     {
-        gchar* font_name;
-        gchar** tokens;
-        guint length;
-
-        g_object_get(settings, "gtk-font-name", &font_name, NULL);
-        tokens = g_strsplit(font_name, " ", -1);
-        length = g_strv_length(tokens);
-        if(length > 1)
+        gint size = atoi(tokens[length - 1]);
+        if(size > 0)
         {
-            gint size = atoi(tokens[length - 1]);
-            if(size > 0)
-            {
-                if(config.a11y.font.is_percent)
-                    size += (int)size*config.a11y.font.increment/100;
-                else
-                    size += config.a11y.font.increment;
-                g_free(tokens[length - 1]);
-                tokens[length - 1] = g_strdup_printf("%d", size);
-                g_free(font_name);
-                font_name = g_strjoinv(" ", tokens);
-                g_object_set(settings, "gtk-font-name", font_name, NULL);
-            }
+            if(config.a11y.font.is_percent)
+                size += (int)size*config.a11y.font.increment/100;
+            else
+                size += config.a11y.font.increment;
+            g_free(tokens[length - 1]);
+            tokens[length - 1] = g_strdup_printf("%d", size);
+            font_name = g_strjoinv(" ", tokens);
         }
-        g_strfreev(tokens);
-        g_free(font_name);
     }
-    else
-    {
-        g_object_set(settings, "gtk-font-name", config.appearance.font, NULL);
-    }
-    set_state_value_int("a11y", "font", a11y.state.font);
-    update_main_window_layout();
+    g_strfreev(tokens);
+    return font_name ? font_name : g_strdup(config.appearance.font);
+}
+
+void a11y_toggle_font(void)
+{
+    g_return_if_fail(config.a11y.font.enabled);
+    apply_a11y_profile(!a11y.state.font, a11y.state.dpi, a11y.state.contrast);
 }
 
 void a11y_toggle_dpi(void)
 {
     g_return_if_fail(config.a11y.dpi.enabled);
-
-    a11y.state.dpi = !a11y.state.dpi;
-    if(greeter.ui.a11y.dpi_widget)
-        set_widget_toggled(greeter.ui.a11y.dpi_widget, a11y.state.dpi, G_CALLBACK(on_a11y_dpi_toggled));
-
-    gint value = config.appearance.dpi;
-    GtkSettings* settings = gtk_settings_get_default();
-    if(a11y.state.dpi)
-    {
-        gint current;
-        g_object_get(settings, "gtk-xft-dpi", &current, NULL);
-        value = get_increment(value, config.a11y.dpi.increment, config.a11y.dpi.is_percent);
-    }
-    g_object_set(settings, "gtk-xft-dpi", value*1024, NULL);
-    set_state_value_int("a11y", "dpi", a11y.state.dpi);
+    apply_a11y_profile(a11y.state.font, !a11y.state.dpi, a11y.state.contrast);
 }
 
 void a11y_toggle_contrast()
 {
     g_return_if_fail(config.a11y.contrast.enabled);
-
-    a11y.state.contrast = !a11y.state.contrast;
-    if(greeter.ui.a11y.contrast_widget)
-        set_widget_toggled(greeter.ui.a11y.contrast_widget, a11y.state.contrast, G_CALLBACK(on_a11y_contrast_toggled));
-
-    GtkSettings* settings = gtk_settings_get_default();
-    apply_gtk_theme(settings, a11y.state.contrast ? config.a11y.contrast.gtk_theme : config.appearance.gtk_theme);
-    apply_icon_theme(settings, a11y.state.contrast ? config.a11y.contrast.icon_theme : config.appearance.icon_theme);
-    set_state_value_int("a11y", "contrast", a11y.state.contrast);
+    apply_a11y_profile(a11y.state.font, a11y.state.dpi, !a11y.state.contrast);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -299,35 +310,131 @@ static gint get_increment(gint value,
     return value + (is_percent ? value*increment/100 : increment);
 }
 
-static gboolean program_is_available(const gchar* name)
+static void on_osk_program_probed(const gchar* name,
+                                  const gchar* path,
+                                  OnscreenKeyboardInfo* keyboard)
+{
+    if(path)
+    {
+        a11y.onscreen_keyboard = keyboard;
+        gtk_widget_show(greeter.ui.a11y.osk_box);
+        /* Start onboard after first frame, toggling will only show or hide it */
+        if(keyboard == &keyboard_onboard.info)
+            keyboard_onboard.restart_id = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)start_onboard, NULL, NULL);
+        return;
+    }
+
+    if(keyboard == &keyboard_onboard.info && keyboard_command.info.get_program())
+    {
+        g_message("a11y: virtual keyboard is not found: %s, trying custom command", name);
+        probe_program(keyboard_command.info.get_program(), (ProgramProbeCallback)on_osk_program_probed,
+                      &keyboard_command.info);
+        return;
+    }
+
+    g_warning("a11y: virtual keyboard is not found: %s", name);
+    config.a11y.osk.enabled = FALSE;
+    if(!config.a11y.contrast.enabled &&
+       !config.a11y.font.enabled &&
+       !config.a11y.dpi.enabled)
+    {
+        g_message("a11y: no options enabled, hiding menu item");
+        config.a11y.enabled = FALSE;
+        gtk_widget_hide(greeter.ui.a11y.widget);
+    }
+}
+
+/* Applies all a11y options at once: GtkSettings notifications are emitted together
+   (one restyle) and state file is written once */
+static void apply_a11y_profile(gboolean font,
+                               gboolean dpi,
+                               gboolean contrast)
 {
-    gchar* cmd = g_strdup_printf("which %s", name);
-    int result = system(cmd);
-    g_free(cmd);
-    return result == 0;
+    const gboolean font_changed = font != a11y.state.font;
+    const gboolean dpi_changed = dpi != a11y.state.dpi;
+    const gboolean contrast_changed = contrast != a11y.state.contrast;
+    if(!font_changed && !dpi_changed && !contrast_changed)
+        return;
+
+    a11y.state.font = font;
+    a11y.state.dpi = dpi;
+    a11y.state.contrast = contrast;
+
+    if(font_changed && greeter.ui.a11y.font_widget)
+        set_widget_toggled(greeter.ui.a11y.font_widget, font, G_CALLBACK(on_a11y_font_toggled));
+    if(dpi_changed && greeter.ui.a11y.dpi_widget)
+        set_widget_toggled(greeter.ui.a11y.dpi_widget, dpi, G_CALLBACK(on_a11y_dpi_toggled));
+    if(contrast_changed && greeter.ui.a11y.contrast_widget)
+        set_widget_toggled(greeter.ui.a11y.contrast_widget, contrast, G_CALLBACK(on_a11y_contrast_toggled));
+
+    GtkSettings* settings = gtk_settings_get_default();
+    g_object_freeze_notify(G_OBJECT(settings));
+    if(font_changed)
+    {
+        gchar* font_name = a11y_get_font_name(font);
+        g_object_set(settings, "gtk-font-name", font_name, NULL);
+        g_free(font_name);
+    }
+    if(dpi_changed)
+    {
+        gint value = config.appearance.dpi;
+        if(dpi)
+            value = get_increment(value, config.a11y.dpi.increment, config.a11y.dpi.is_percent);
+        g_object_set(settings, "gtk-xft-dpi", value*1024, NULL);
+    }
+    if(contrast_changed)
+    {
+        apply_gtk_theme(settings, contrast ? config.a11y.contrast.gtk_theme : config.appearance.gtk_theme);
+        apply_icon_theme(settings, contrast ? config.a11y.contrast.icon_theme : config.appearance.icon_theme);
+    }
+    g_object_thaw_notify(G_OBJECT(settings));
+
+    freeze_state();
+    if(font_changed)
+        set_state_value_int("a11y", "font", font);
+    if(dpi_changed)
+        set_state_value_int("a11y", "dpi", dpi);
+    if(contrast_changed)
+        set_state_value_int("a11y", "contrast", contrast);
+    thaw_state();
+
+    if(font_changed)
+        update_main_window_layout();
 }
 
-static gboolean osk_check_custom(void)
+/* Parse CSS for the theme that is not applied now, so contrast toggling only swaps providers */
+static gboolean preload_contrast_theme(gpointer dummy)
 {
-    return config.a11y.osk.command && program_is_available(config.a11y.osk.command[0]);
+    preload_gtk_theme(a11y.state.contrast ? config.appearance.gtk_theme : config.a11y.contrast.gtk_theme);
+    return G_SOURCE_REMOVE;
+}
+
+static const gchar* osk_get_program_custom(void)
+{
+    return config.a11y.osk.command ? config.a11y.osk.command[0] : NULL;
 }
 
 static void osk_open_custom(void)
 {
     g_message("Opening on-screen keyboard");
     g_return_if_fail(config.a11y.osk.command != NULL);
-    osk_close_custom();
+    if(keyboard_command.pid)
+        osk_close_custom();
 
     GError* error = NULL;
-    if(!g_spawn_async(NULL, config.a11y.osk.command, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, &keyboard_command.pid, &error))
+    if(!g_spawn_async(NULL, config.a11y.osk.command, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                      NULL, NULL, &keyboard_command.pid, &error))
     {
+        keyboard_command.pid = 0;
         a11y.onscreen_keyboard = NULL;
         gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(greeter.ui.a11y.osk_widget), FALSE);
         g_warning("On-screen keyboard command error: %s", error->message);
         show_message_dialog(GTK_MESSAGE_ERROR, _("On-screen keyboard"),
                             _("Failed to start keyboard command:\n%s"), error->message);
         g_clear_error(&error);
+        return;
     }
+    g_child_watch_add(keyboard_command.pid, on_custom_osk_exited, NULL);
 }
 
 static void osk_close_custom(void)
@@ -335,139 +442,266 @@ static void osk_close_custom(void)
     g_message("Killing on-screen keyboard");
     g_return_if_fail(keyboard_command.pid != 0);
     kill(keyboard_command.pid, SIGTERM);
-    g_spawn_close_pid(keyboard_command.pid);
     keyboard_command.pid = 0;
 }
 
 static void osk_kill_custom(void)
 {
-    osk_close_custom();
+    if(keyboard_command.pid)
+        osk_close_custom();
 }
 
-static gboolean osk_check_onboard(void)
+/* Keyboard window was closed by user or process crashed: reset menu item state */
+static void on_custom_osk_exited(GPid pid,
+                                 gint status,
+                                 gpointer data)
+{
+    g_spawn_close_pid(pid);
+    if(pid != keyboard_command.pid)
+        return;
+
+    g_message("On-screen keyboard exited (status: %d)", status);
+    keyboard_command.pid = 0;
+    if(a11y.state.osk)
+    {
+        a11y.state.osk = FALSE;
+        if(greeter.ui.a11y.osk_widget)
+            set_widget_toggled(greeter.ui.a11y.osk_widget, FALSE, G_CALLBACK(on_a11y_osk_toggled));
+    }
+}
+
+static const gchar* osk_get_program_onboard(void)
 {
     /* we need widget to place "onboard" in it */
-    return greeter.ui.onboard_content && program_is_available("onboard");
+    return greeter.ui.onboard_content || config.appearance.onboard_ui_file ? "onboard" : NULL;
+}
+
+static void osk_open_onboard(void)
+{
+    if(keyboard_onboard.socket)
+        gtk_widget_show(greeter.ui.onboard_layout);
+    else if(!keyboard_onboard.pid && !spawn_onboard())
+        stop_onboard_restarts();
+    /* Otherwise onboard is starting now, it will be shown by embed_onboard() */
+}
+
+static void osk_close_onboard(void)
+{
+    if(greeter.ui.onboard_layout)
+        gtk_widget_hide(greeter.ui.onboard_layout);
 }
 
+static void osk_kill_onboard(void)
+{
+    keyboard_onboard.stopping = TRUE;
+    if(keyboard_onboard.restart_id)
+        g_source_remove(keyboard_onboard.restart_id);
+    if(keyboard_onboard.output_watch)
+        g_source_remove(keyboard_onboard.output_watch);
+    if(keyboard_onboard.child_watch)
+        g_source_remove(keyboard_onboard.child_watch);
+    keyboard_onboard.restart_id = keyboard_onboard.output_watch = keyboard_onboard.child_watch = 0;
+
+    if(keyboard_onboard.socket)
+    {
+        gtk_widget_hide(greeter.ui.onboard_layout);
+        gtk_widget_destroy(GTK_WIDGET(keyboard_onboard.socket));
+        keyboard_onboard.socket = NULL;
+    }
+    if(keyboard_onboard.pid)
+    {
+        kill(keyboard_onboard.pid, SIGTERM);
+        /* Only to reap it, restarting is already disabled */
+        g_child_watch_add(keyboard_onboard.pid, on_killed_onboard_exited, NULL);
+        keyboard_onboard.pid = 0;
+    }
+}
+
+/* Starts "onboard" without waiting for it: XID is read by on_onboard_output() */
 static gboolean spawn_onboard(void)
 {
+    WATCHDOG_OPERATION("spawn_onboard");
     gchar* COMMAND_LINE[] = {"onboard", "--xid", NULL};
-    GPid pid = 0;
-    GtkSocket* socket = NULL;
     GError* error = NULL;
     gint out_fd = 0;
 
+    if(!load_ui_fragment(UI_FRAGMENT_ONBOARD))
+        return FALSE;
+
     if(!g_spawn_async_with_pipes(NULL,
                                  COMMAND_LINE,
                                  NULL,
-                                 G_SPAWN_SEARCH_PATH,
+                                 G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
                                  NULL,
                                  NULL,
-                                 &pid,
+                                 &keyboard_onboard.pid,
                                  NULL, &out_fd, NULL,
                                  &error))
     {
         g_warning("\"Onboard\" command failed: %s", error->message);
         g_clear_error(&error);
+        keyboard_onboard.pid = 0;
         return FALSE;
     }
 
-    gchar* text = NULL;
+    g_message("\"Onboard\" started: %d", keyboard_onboard.pid);
+
     GIOChannel* out_channel = g_io_channel_unix_new(out_fd);
+    g_io_channel_set_close_on_unref(out_channel, TRUE);
+    g_io_channel_set_flags(out_channel, G_IO_FLAG_NONBLOCK, NULL);
+    keyboard_onboard.output_watch = g_io_add_watch(out_channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                                   (GIOFunc)on_onboard_output, NULL);
+    g_io_channel_unref(out_channel);
+    keyboard_onboard.child_watch = g_child_watch_add(keyboard_onboard.pid, on_onboard_exited, NULL);
+    return TRUE;
+}
+
+static gboolean start_onboard(gpointer dummy)
+{
+    keyboard_onboard.restart_id = 0;
+    if(!keyboard_onboard.stopping && !keyboard_onboard.pid && !spawn_onboard())
+        stop_onboard_restarts();
+    return G_SOURCE_REMOVE;
+}
+
+/* Places "onboard" window into hidden onboard_layout */
+static void embed_onboard(Window xid)
+{
+    g_message("\"Onboard\" socket: %lu", xid);
+
+    gboolean at_top;
+    switch(config.a11y.osk.onboard_position)
+    {
+    case ONBOARD_POS_TOP: at_top = TRUE; break;
+    case ONBOARD_POS_BOTTOM: at_top = FALSE; break;
+    case ONBOARD_POS_PANEL: at_top = config.panel.position == PANEL_POS_TOP; break;
+    case ONBOARD_POS_PANEL_OPPOSITE: at_top = config.panel.position != PANEL_POS_TOP;
+    };
+
+    rearrange_grid_child(GTK_GRID(greeter.ui.screen_layout), greeter.ui.onboard_layout,
+                         at_top ? UI_LAYOUT_ROW_ONBOARD_TOP : UI_LAYOUT_ROW_ONBOARD_BOTTOM);
+
+    if(config.a11y.osk.onboard_height_is_percent)
+    {
+        GdkRectangle geometry;
+        GdkScreen* screen = gtk_window_get_screen(GTK_WINDOW(greeter.ui.screen_window));
+        gdk_screen_get_monitor_geometry(screen, gdk_screen_get_primary_monitor(screen), &geometry);
+        gtk_widget_set_size_request(greeter.ui.onboard_layout,
+                                    -1, geometry.height*config.a11y.osk.onboard_height/100);
+    }
+    else
+        gtk_widget_set_size_request(greeter.ui.onboard_content, -1, config.a11y.osk.onboard_height);
+
+    keyboard_onboard.socket = GTK_SOCKET(gtk_socket_new());
+    /* Socket is destroyed in on_onboard_exited(), not when plug is removed */
+    g_signal_connect(keyboard_onboard.socket, "plug-removed", G_CALLBACK(gtk_true), NULL);
+    gtk_container_add(GTK_CONTAINER(greeter.ui.onboard_content), GTK_WIDGET(keyboard_onboard.socket));
+    gtk_socket_add_id(keyboard_onboard.socket, xid);
+    gtk_widget_show(GTK_WIDGET(keyboard_onboard.socket));
+    /* Failures counter is reset by on_onboard_exited() if onboard was running long enough */
+    keyboard_onboard.embed_time = g_get_monotonic_time();
+
+    /* Keyboard was requested while onboard was starting */
+    if(a11y.state.osk)
+    {
+        gtk_widget_show(greeter.ui.onboard_layout);
+        update_main_window_layout();
+    }
+}
+
+/* Onboard failed too many times or can not be started: disable keyboard */
+static void stop_onboard_restarts(void)
+{
+    g_warning("\"Onboard\" is not available");
+    a11y.onscreen_keyboard = NULL;
+    if(greeter.ui.a11y.osk_box)
+        gtk_widget_hide(greeter.ui.a11y.osk_box);
+    if(a11y.state.osk)
+    {
+        a11y.state.osk = FALSE;
+        if(greeter.ui.a11y.osk_widget)
+            set_widget_toggled(greeter.ui.a11y.osk_widget, FALSE, G_CALLBACK(on_a11y_osk_toggled));
+        show_message_dialog(GTK_MESSAGE_ERROR, _("Onboard"),
+                            _("Failed to start 'onboard', see logs for details."));
+    }
+}
+
+static gboolean on_onboard_output(GIOChannel* channel,
+                                  GIOCondition condition,
+                                  gpointer data)
+{
+    gchar* text = NULL;
+    GError* error = NULL;
+    GIOStatus status = g_io_channel_read_line(channel, &text, NULL, NULL, &error);
 
-    g_return_val_if_fail(out_channel != NULL, FALSE);
+    if(status == G_IO_STATUS_AGAIN)
+        return G_SOURCE_CONTINUE;
 
-    if(g_io_channel_read_line(out_channel, &text, NULL, NULL, &error) == G_IO_STATUS_NORMAL)
+    keyboard_onboard.output_watch = 0;
+    if(status == G_IO_STATUS_NORMAL)
     {
         gchar* end_ptr = NULL;
 
         text = g_strstrip(text);
-        gint id = g_ascii_strtoll(text, &end_ptr, 0);
+        guint64 id = g_ascii_strtoull(text, &end_ptr, 0);
 
         if(id == 0 || (end_ptr && *end_ptr != '\0'))
-        {
             g_warning("Unrecognized output from 'onboard': '%s'", text);
-        }
-        else if(!(socket = GTK_SOCKET(gtk_socket_new())))
-        {
-            g_warning("Can not connect to 'onboard': %s", error->message);
-            g_clear_error(&error);
-        }
         else
-        {
-            g_message("\"Onboard\" socket: %d", id);
-            gboolean at_top;
-            switch(config.a11y.osk.onboard_position)
-            {
-            case ONBOARD_POS_TOP: at_top = TRUE; break;
-            case ONBOARD_POS_BOTTOM: at_top = FALSE; break;
-            case ONBOARD_POS_PANEL: at_top = config.panel.position == PANEL_POS_TOP; break;
-            case ONBOARD_POS_PANEL_OPPOSITE: at_top = config.panel.position != PANEL_POS_TOP;
-            };
-
-            rearrange_grid_child(GTK_GRID(greeter.ui.screen_layout), greeter.ui.onboard_layout,
-                                 at_top ? UI_LAYOUT_ROW_ONBOARD_TOP : UI_LAYOUT_ROW_ONBOARD_BOTTOM);
-
-            if(config.a11y.osk.onboard_height_is_percent)
-            {
-                GdkRectangle geometry;
-                GdkScreen* screen = gtk_window_get_screen(GTK_WINDOW(greeter.ui.screen_window));
-                gdk_screen_get_monitor_geometry(screen, gdk_screen_get_primary_monitor(screen), &geometry);
-                gtk_widget_set_size_request(greeter.ui.onboard_layout,
-                                            -1, geometry.height*config.a11y.osk.onboard_height/100);
-            }
-            else
-                gtk_widget_set_size_request(greeter.ui.onboard_content, -1, config.a11y.osk.onboard_height);
-            gtk_container_add(GTK_CONTAINER(greeter.ui.onboard_content), GTK_WIDGET(socket));
-            gtk_socket_add_id(socket, atol(text));
-            gtk_widget_show(GTK_WIDGET(socket));
-        }
+            embed_onboard(id);
     }
     else if(error)
         g_warning("Can not read \"Onboard\" output: %s", error->message);
 
     g_clear_error(&error);
     g_free(text);
-    g_io_channel_unref(out_channel);
 
-    if(!socket && pid != 0)
-    {
-        kill(pid, SIGTERM);
-        g_spawn_close_pid(pid);
-    }
-    else if(socket)
-    {
-        keyboard_onboard.pid = pid;
-        keyboard_onboard.socket = socket;
-    }
-    return socket != NULL;
+    /* on_onboard_exited() will count this start as failed */
+    if(!keyboard_onboard.socket && keyboard_onboard.pid)
+        kill(keyboard_onboard.pid, SIGTERM);
+    return G_SOURCE_REMOVE;
 }
 
-static void osk_open_onboard(void)
+/* Health check: restart "onboard" if it died */
+static void on_onboard_exited(GPid pid,
+                              gint status,
+                              gpointer data)
 {
-    if(!keyboard_onboard.socket && !spawn_onboard())
+    g_spawn_close_pid(pid);
+    keyboard_onboard.pid = 0;
+    keyboard_onboard.child_watch = 0;
+    if(keyboard_onboard.output_watch)
     {
-        show_message_dialog(GTK_MESSAGE_ERROR, _("Onboard"),
-                            _("Failed to start 'onboard', see logs for details."));
-        gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(greeter.ui.a11y.osk_widget), FALSE);
-        a11y.onscreen_keyboard = NULL;
-        return;
+        g_source_remove(keyboard_onboard.output_watch);
+        keyboard_onboard.output_watch = 0;
     }
-    gtk_widget_show(greeter.ui.onboard_layout);
-}
 
-static void osk_close_onboard(void)
-{
-    gtk_widget_hide(greeter.ui.onboard_layout);
+    if(keyboard_onboard.socket)
+    {
+        if(greeter.ui.onboard_layout)
+            gtk_widget_hide(greeter.ui.onboard_layout);
+        gtk_widget_destroy(GTK_WIDGET(keyboard_onboard.socket));
+        keyboard_onboard.socket = NULL;
+        if(a11y.state.osk)
+            update_main_window_layout();
+        if(g_get_monotonic_time() - keyboard_onboard.embed_time >= ONBOARD_MIN_UPTIME*G_USEC_PER_SEC)
+            keyboard_onboard.failures = 0;
+        else
+            keyboard_onboard.failures++;
+    }
+    else
+        keyboard_onboard.failures++;
+
+    g_warning("\"Onboard\" exited (status: %d)", status);
+    if(keyboard_onboard.failures >= ONBOARD_MAX_FAILURES)
+        stop_onboard_restarts();
+    else
+        keyboard_onboard.restart_id = g_timeout_add_seconds(ONBOARD_RESTART_DELAY, (GSourceFunc)start_onboard, NULL);
 }
 
-static void osk_kill_onboard(void)
+static void on_killed_onboard_exited(GPid pid,
+                                     gint status,
+                                     gpointer data)
 {
-    g_return_if_fail(keyboard_onboard.pid != 0);
-    gtk_widget_hide(GTK_WIDGET(greeter.ui.onboard_content));
-    gtk_container_remove(GTK_CONTAINER(greeter.ui.onboard_content), gtk_bin_get_child(GTK_BIN(greeter.ui.onboard_content)));
-    kill(keyboard_onboard.pid, SIGTERM);
-    g_spawn_close_pid(keyboard_onboard.pid);
-    keyboard_onboard.pid = 0;
+    g_spawn_close_pid(pid);
 }
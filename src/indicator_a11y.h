@@ -31,5 +31,7 @@ void a11y_toggle_osk                   (void);
 void a11y_toggle_font                  (void);
 void a11y_toggle_dpi                   (void);
 void a11y_toggle_contrast              (void);
+/* Font name for normal or enlarged state, thread safe */
+gchar* a11y_get_font_name              (gboolean enlarged);
 
 #endif // _INDICATOR_A11Y_H_INCLUDED_
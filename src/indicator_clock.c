@@ -21,7 +21,16 @@
     #include "config.h"
 #endif
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 #include <glib/gi18n.h>
+#include <glib-unix.h>
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+    #define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
 
 #ifdef CLOCK_USE_IDO_CALENDAR
     #include <libido/libido.h>
@@ -31,13 +40,68 @@
 #include "indicator_clock.h"
 #include "shares.h"
 
+/* Types */
+
+/* Smallest time unit shown by format, seconds */
+typedef enum
+{
+    CLOCK_UNIT_SECOND = 1,
+    CLOCK_UNIT_MINUTE = 60,
+    CLOCK_UNIT_HOUR   = 60*60,
+    CLOCK_UNIT_DAY    = 24*60*60
+} ClockUnit;
+
+typedef struct
+{
+    GtkWidget*  widget;
+    gchar*      format;
+    ClockUnit   unit;
+    /* Text that is set now, label is not touched if it is not changed */
+    gchar*      text;
+} ClockLabel;
+
+/* Static constants */
+
+/* Conversions of g_date_time_format(), others are updated every second */
+static const struct
+{
+    const gchar* conversions;
+    ClockUnit    unit;
+} CLOCK_FORMAT_UNITS[] =
+{
+    {"aAbBhdeCgGjmuUVwWyYxDF", CLOCK_UNIT_DAY},
+    {"HIklpPzZ",             CLOCK_UNIT_HOUR},
+    {"MR",                   CLOCK_UNIT_MINUTE},
+    {NULL, 0}
+};
+
+/* Fallback timer (if timerfd is not available) does not notice wall clock changes and suspend,
+   this limits time of showing wrong text, ms */
+static const guint CLOCK_MAX_TIMEOUT = 60*1000;
+
 /* Static variables */
 
 static gulong visibility_notify_id = 0;
 
+static struct
+{
+    GSList*     labels;
+    gboolean    suspended;
+    /* CLOCK_REALTIME timer: fires at boundary time after resume and when wall clock is changed */
+    gint        timer_fd;
+    guint       timer_source;
+    guint       timeout_id;
+} clock_data = {.timer_fd = -1};
+
 /* Static functions */
 
-static gboolean clock_handler                    (gpointer* data);
+static ClockUnit get_format_unit                 (const gchar* format);
+static void update_clock_labels                  (void);
+static void schedule_clock_update                (void);
+static gboolean on_clock_timer                   (gint fd,
+                                                  GIOCondition condition,
+                                                  gpointer data);
+static gboolean on_clock_timeout                 (gpointer data);
 #ifndef CLOCK_USE_IDO_CALENDAR
 static GtkWidget* create_simple_calendar_item    (GtkWidget** calendar_out);
 #endif
@@ -90,25 +154,176 @@ void init_clock_indicator(void)
 
     if(greeter.ui.clock.time_widget)
     {
-        clock_handler(NULL);
-        g_timeout_add_seconds(1, (GSourceFunc)clock_handler, (gpointer)TRUE);
+        clock_add_label(greeter.ui.clock.time_widget, config.clock.time_format);
         gtk_widget_show(greeter.ui.clock.time_widget);
     }
 }
 
+void clock_add_label(GtkWidget* widget,
+                     const gchar* format)
+{
+    g_return_if_fail(widget != NULL && format != NULL);
+
+    ClockLabel* label = g_malloc0(sizeof(ClockLabel));
+    label->widget = widget;
+    label->format = g_strdup(format);
+    label->unit = get_format_unit(format);
+    clock_data.labels = g_slist_prepend(clock_data.labels, label);
+
+    if(clock_data.timer_fd < 0 && !clock_data.timeout_id)
+    {
+        clock_data.timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(clock_data.timer_fd >= 0)
+            clock_data.timer_source = g_unix_fd_add(clock_data.timer_fd, G_IO_IN, on_clock_timer, NULL);
+        else
+            g_warning("Clock: timerfd is not available: %s", g_strerror(errno));
+    }
+
+    if(!clock_data.suspended)
+    {
+        update_clock_labels();
+        schedule_clock_update();
+    }
+}
+
+void clock_suspend(void)
+{
+    clock_data.suspended = TRUE;
+    if(clock_data.timer_fd >= 0)
+    {
+        const struct itimerspec disarm = {{0, 0}, {0, 0}};
+        timerfd_settime(clock_data.timer_fd, 0, &disarm, NULL);
+    }
+    if(clock_data.timeout_id)
+    {
+        g_source_remove(clock_data.timeout_id);
+        clock_data.timeout_id = 0;
+    }
+}
+
+void clock_resume(void)
+{
+    if(!clock_data.suspended)
+        return;
+    clock_data.suspended = FALSE;
+    update_clock_labels();
+    schedule_clock_update();
+}
+
  /* ---------------------------------------------------------------------------*
  * Definitions: static
  * -------------------------------------------------------------------------- */
 
-static gboolean clock_handler(gpointer* data)
+static ClockUnit get_format_unit(const gchar* format)
+{
+    ClockUnit unit = CLOCK_UNIT_DAY;
+    for(const gchar* p = strchr(format, '%'); p && p[1]; p = strchr(p, '%'))
+    {
+        /* Skip flags and modifiers: %-d, %_H, %Ey, %:z */
+        for(++p; *p && strchr("-_0^#EO:", *p); ++p);
+        if(!*p)
+            break;
+        if(*p++ == '%')
+            continue;
+
+        ClockUnit conversion_unit = CLOCK_UNIT_SECOND;
+        for(gint i = 0; CLOCK_FORMAT_UNITS[i].conversions; ++i)
+            if(strchr(CLOCK_FORMAT_UNITS[i].conversions, p[-1]))
+            {
+                conversion_unit = CLOCK_FORMAT_UNITS[i].unit;
+                break;
+            }
+        unit = MIN(unit, conversion_unit);
+    }
+    return unit;
+}
+
+static void update_clock_labels(void)
 {
     GDateTime* datetime = g_date_time_new_now_local();
-    g_return_val_if_fail(datetime != NULL, FALSE);
-    gchar* str = g_date_time_format(datetime, config.clock.time_format);
-    set_widget_text(greeter.ui.clock.time_widget, str);
-    g_free(str);
+    g_return_if_fail(datetime != NULL);
+
+    for(GSList* item = clock_data.labels; item; item = item->next)
+    {
+        ClockLabel* label = item->data;
+        gchar* text = g_date_time_format(datetime, label->format);
+        if(g_strcmp0(text, label->text) != 0)
+        {
+            set_widget_text(label->widget, text);
+            g_free(label->text);
+            label->text = text;
+        }
+        else
+            g_free(text);
+    }
     g_date_time_unref(datetime);
-    return TRUE;
+}
+
+/* Wake up at the nearest time when text of some label can change */
+static void schedule_clock_update(void)
+{
+    ClockUnit unit = CLOCK_UNIT_DAY;
+    for(GSList* item = clock_data.labels; item; item = item->next)
+        unit = MIN(unit, ((ClockLabel*)item->data)->unit);
+
+    GDateTime* now = g_date_time_new_now_local();
+    g_return_if_fail(now != NULL);
+
+    /* Boundary is computed from now, not from local date and time: local time is ambiguous
+       when clock is set back. Local seconds are used: time zone offset is not always a whole number of hours */
+    const gint hour = g_date_time_get_hour(now);
+    const gint minute = g_date_time_get_minute(now);
+    const gint second = g_date_time_get_second(now);
+    gint64 next_time;
+    if(unit == CLOCK_UNIT_DAY)
+    {
+        GDateTime* next = g_date_time_add_full(now, 0, 0, 1, -hour, -minute, -second);
+        next_time = g_date_time_to_unix(next);
+        g_date_time_unref(next);
+    }
+    else
+        next_time = g_date_time_to_unix(now) - (hour*CLOCK_UNIT_HOUR + minute*CLOCK_UNIT_MINUTE + second) % unit + unit;
+
+    if(clock_data.timer_fd >= 0)
+    {
+        const struct itimerspec spec = {{0, 0}, {next_time, 0}};
+        if(timerfd_settime(clock_data.timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL) != 0)
+            g_warning("Clock: failed to set timer: %s", g_strerror(errno));
+    }
+    else
+    {
+        gint64 delay = (next_time*G_USEC_PER_SEC - g_get_real_time())/1000 + 1;
+        if(clock_data.timeout_id)
+            g_source_remove(clock_data.timeout_id);
+        clock_data.timeout_id = g_timeout_add(CLAMP(delay, 1, CLOCK_MAX_TIMEOUT), on_clock_timeout, NULL);
+    }
+
+    g_date_time_unref(now);
+}
+
+static gboolean on_clock_timer(gint fd,
+                               GIOCondition condition,
+                               gpointer data)
+{
+    guint64 expirations;
+    /* ECANCELED: wall clock was changed, labels must be updated anyway */
+    if(read(fd, &expirations, sizeof(expirations)) < 0 && errno != ECANCELED && errno != EAGAIN)
+        g_warning("Clock: failed to read timer: %s", g_strerror(errno));
+
+    if(!clock_data.suspended)
+    {
+        update_clock_labels();
+        schedule_clock_update();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_clock_timeout(gpointer data)
+{
+    clock_data.timeout_id = 0;
+    update_clock_labels();
+    schedule_clock_update();
+    return G_SOURCE_REMOVE;
 }
 
 #ifndef CLOCK_USE_IDO_CALENDAR
@@ -24,7 +24,14 @@
 
 /* Functions */
 
-void init_clock_indicator              (void);
+void init_clock_indicator              (void);
+/* Keeps widget text formatted with current time. All labels share one timer that wakes up
+   only at times when text of some label can change */
+void clock_add_label                   (GtkWidget* widget,
+                                        const gchar* format);
+/* Stop updating labels, clock_resume() updates them immediately */
+void clock_suspend                     (void);
+void clock_resume                      (void);
 
 
 #endif // _INDICATOR_CLOCK_H_INCLUDED_
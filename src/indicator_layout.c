@@ -23,12 +23,15 @@
 #include <X11/Xlib.h>
 #include <X11/XKBlib.h>
 #include <gtk/gtk.h>
+#include <gdk/gdkx.h>
 #include <glib/gi18n.h>
 #include <libxklavier/xklavier.h>
 
 #include "shares.h"
 #include "configuration.h"
 #include "indicator_layout.h"
+#include "probes.h"
+#include "x11_utils.h"
 /* Types */
 
 struct _KeyboardInfo;
@@ -45,10 +48,13 @@ typedef struct _GroupInfo
 typedef struct _KeyboardInfo
 {
     Display* display;
+    /* NULL for direct XKB backend */
     XklEngine* engine;
     GroupInfo* groups;
     gint groups_count;
     gulong state_callback_id;
+    /* Direct XKB backend: XKB events base on GDK connection */
+    int xkb_event_base;
 } KeyboardInfo;
 
 /* Events */
@@ -63,10 +69,17 @@ static void state_callback             (XklEngine* engine,
 static GdkFilterReturn xkb_evt_filter  (GdkXEvent* xev,
                                         GdkEvent* event,
                                         KeyboardInfo* kbd);
+static GdkFilterReturn xkb_direct_evt_filter (GdkXEvent* xev,
+                                              GdkEvent* event,
+                                              KeyboardInfo* kbd);
+static void on_xkb_display_probed      (Display* display,
+                                        gpointer data);
 
 /* Static functions */
 
-static KeyboardInfo* init_xkb          (void);
+static void show_indicator             (KeyboardInfo* kbd);
+static KeyboardInfo* init_xkb          (Display* display);
+static KeyboardInfo* init_xkb_direct   (void);
 static void start_monitoring           (KeyboardInfo* kbd);
 static gchar** get_layouts             (Display* display);
 static GroupInfo* get_groups           (Display* display,
@@ -79,48 +92,41 @@ static void update_menu                (GroupInfo* group_info);
 
 void init_layout_indicator(void)
 {
+    /* Indicator is shown when XKB display is opened, see show_indicator() */
+    gtk_widget_hide(greeter.ui.layout.box);
     if(!config.layout.enabled)
-    {
-        gtk_widget_hide(greeter.ui.layout.box);
-        return;
-    }
-
-    KeyboardInfo* kbd = init_xkb();
-    if(!kbd)
-    {
-        g_critical("Layout indicator: initialization failed, hiding widget");
-        gtk_widget_hide(greeter.ui.layout.box);
         return;
-    }
-
-    GSList* menu_group = NULL;
-    GtkWidget* menu_item = NULL;
-    for(int i = 0; i < kbd->groups_count; i++)
-    {
-        menu_item = gtk_radio_menu_item_new_with_label(menu_group, kbd->groups[i].name);
-        menu_group = gtk_radio_menu_item_get_group(GTK_RADIO_MENU_ITEM(menu_item));
-        kbd->groups[i].menu_item = menu_item;
-        g_signal_connect(G_OBJECT(menu_item), "toggled", G_CALLBACK(on_layout_clicked), (gpointer)&kbd->groups[i]);
-        gtk_menu_shell_append(GTK_MENU_SHELL(greeter.ui.layout.menu), menu_item);
-    }
-
-    start_monitoring(kbd);
-
-    gtk_widget_show_all(greeter.ui.layout.box);
-    gtk_widget_show_all(greeter.ui.layout.menu);
+    if(config.layout.backend == LAYOUT_BACKEND_XKB)
+        show_indicator(init_xkb_direct());
+    else
+        probe_xkb_display(on_xkb_display_probed, NULL);
 }
 
 /* ------------------------------------------------------------------------- *
  * Definitions: events
  * ------------------------------------------------------------------------- */
 
+static void on_xkb_display_probed(Display* display,
+                                  gpointer data)
+{
+    show_indicator(display ? init_xkb(display) : NULL);
+}
+
 static void on_layout_clicked(GtkRadioMenuItem* menu_item,
                               GroupInfo* group)
 {
     if(gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(menu_item)))
     {
-        xkl_engine_allow_one_switch_to_secondary_group(group->kbd->engine);
-        xkl_engine_lock_group(group->kbd->engine, group->group_id);
+        if(group->kbd->engine)
+        {
+            xkl_engine_allow_one_switch_to_secondary_group(group->kbd->engine);
+            xkl_engine_lock_group(group->kbd->engine, group->group_id);
+        }
+        else
+        {
+            XkbLockGroup(group->kbd->display, XkbUseCoreKbd, group->group_id);
+            XFlush(group->kbd->display);
+        }
     }
 }
 
@@ -142,25 +148,62 @@ static GdkFilterReturn xkb_evt_filter(GdkXEvent* xev,
 	return GDK_FILTER_CONTINUE;
 }
 
+static GdkFilterReturn xkb_direct_evt_filter(GdkXEvent* xev,
+                                             GdkEvent* event,
+                                             KeyboardInfo* kbd)
+{
+    /* All XKB events share one event type, everything else is passed by this check */
+    if(((XEvent*)xev)->type != kbd->xkb_event_base)
+        return GDK_FILTER_CONTINUE;
+
+    const XkbEvent* xkb_event = (const XkbEvent*)xev;
+    if(xkb_event->any.xkb_type == XkbStateNotify && (xkb_event->state.changed & XkbGroupStateMask) &&
+       xkb_event->state.group < kbd->groups_count)
+        update_menu(&kbd->groups[xkb_event->state.group]);
+    return GDK_FILTER_CONTINUE;
+}
+
 /* ------------------------------------------------------------------------- *
  * Definitions: static
  * ------------------------------------------------------------------------- */
 
-static KeyboardInfo* init_xkb()
+static void show_indicator(KeyboardInfo* kbd)
+{
+    if(!kbd)
+    {
+        g_critical("Layout indicator: initialization failed, hiding widget");
+        return;
+    }
+
+    GSList* menu_group = NULL;
+    GtkWidget* menu_item = NULL;
+    for(int i = 0; i < kbd->groups_count; i++)
+    {
+        menu_item = gtk_radio_menu_item_new_with_label(menu_group, kbd->groups[i].name);
+        menu_group = gtk_radio_menu_item_get_group(GTK_RADIO_MENU_ITEM(menu_item));
+        kbd->groups[i].menu_item = menu_item;
+        g_signal_connect(G_OBJECT(menu_item), "toggled", G_CALLBACK(on_layout_clicked), (gpointer)&kbd->groups[i]);
+        gtk_menu_shell_append(GTK_MENU_SHELL(greeter.ui.layout.menu), menu_item);
+    }
+
+    start_monitoring(kbd);
+
+    gtk_widget_show_all(greeter.ui.layout.box);
+    gtk_widget_show_all(greeter.ui.layout.menu);
+}
+
+static KeyboardInfo* init_xkb(Display* display)
 {
-    Display* display;
     XklEngine* engine;
     GroupInfo* groups;
     int groups_count;
 
-    display = XkbOpenDisplay(NULL, NULL, NULL, NULL, NULL, NULL);
-    g_return_val_if_fail(display != NULL, NULL);
     engine = xkl_engine_get_instance(display);
     g_return_val_if_fail(display != NULL, NULL);
     groups = get_groups(display, &groups_count);
     g_return_val_if_fail(display != NULL, NULL);
 
-    KeyboardInfo* kbd = g_malloc(sizeof(KeyboardInfo));
+    KeyboardInfo* kbd = g_malloc0(sizeof(KeyboardInfo));
     kbd->display = display;
     kbd->engine = engine;
     kbd->groups = groups;
@@ -173,13 +216,53 @@ static KeyboardInfo* init_xkb()
     return kbd;
 }
 
+/* Use XKB on GDK connection, without libxklavier and second display connection */
+static KeyboardInfo* init_xkb_direct(void)
+{
+    Display* display = gdk_x11_get_default_xdisplay();
+    int opcode, event_base, error_base;
+    int major = XkbMajorVersion, minor = XkbMinorVersion;
+    x11_count_round_trip(1);
+    if(!XkbQueryExtension(display, &opcode, &event_base, &error_base, &major, &minor))
+    {
+        g_warning("Layout indicator: XKB extension is not available");
+        return NULL;
+    }
+
+    int groups_count;
+    GroupInfo* groups = get_groups(display, &groups_count);
+    g_return_val_if_fail(groups != NULL, NULL);
+
+    KeyboardInfo* kbd = g_malloc0(sizeof(KeyboardInfo));
+    kbd->display = display;
+    kbd->groups = groups;
+    kbd->groups_count = groups_count;
+    kbd->xkb_event_base = event_base;
+
+    for(int i = 0; i < groups_count; ++i)
+        groups[i].kbd = kbd;
+
+    return kbd;
+}
+
 static void start_monitoring(KeyboardInfo* kbd)
 {
     XkbStateRec state;
     XkbGetState(kbd->display, XkbUseCoreKbd, &state);
+    x11_count_round_trip(1);
     update_menu(&kbd->groups[state.group]);
-    gdk_window_add_filter(NULL, (GdkFilterFunc)xkb_evt_filter, (gpointer)kbd);
-    xkl_engine_start_listen(kbd->engine, XKLL_TRACK_KEYBOARD_STATE);
+    if(kbd->engine)
+    {
+        gdk_window_add_filter(NULL, (GdkFilterFunc)xkb_evt_filter, (gpointer)kbd);
+        xkl_engine_start_listen(kbd->engine, XKLL_TRACK_KEYBOARD_STATE);
+    }
+    else
+    {
+        /* Only group changes, other XKB state events selected by GDK are not affected */
+        XkbSelectEventDetails(kbd->display, XkbUseCoreKbd, XkbStateNotify,
+                              XkbGroupStateMask, XkbGroupStateMask);
+        gdk_window_add_filter(NULL, (GdkFilterFunc)xkb_direct_evt_filter, (gpointer)kbd);
+    }
 }
 
 static gchar** get_layouts(Display* display)
@@ -191,13 +274,14 @@ static gchar** get_layouts(Display* display)
     unsigned long bytes_after;
     unsigned char *prop;
     int status = XGetWindowProperty(display, RootWindow(display, DefaultScreen(display)),
-                                    XInternAtom(display, "_XKB_RULES_NAMES", 1),
+                                    x11_get_atom(X11_ATOM_XKB_RULES_NAMES),
                                     0, 1024,          /* Offset, length */
                                     FALSE,            /* Delete */
                                     XA_STRING, &type, /* Requared type, actual type */
                                     &format,
                                     &nitems, &bytes_after,
                                     &prop);
+    x11_count_round_trip(1);
 
     g_return_val_if_fail(status == Success, NULL);
     g_return_val_if_fail((int)nitems >= LAYOUTS_PROP_NUM, NULL);
@@ -217,22 +301,29 @@ static GroupInfo* get_groups(Display* display,
 {
     gchar** short_names = get_layouts(display);
     g_return_val_if_fail(short_names != NULL, NULL);
-    *count = g_strv_length(short_names);
+    *count = MIN(g_strv_length(short_names), XkbNumKbdGroups);
     g_return_val_if_fail(*count > (config.layout.enabled_for_one ? 0 : 1), NULL);
     XkbDescPtr xkb = XkbAllocKeyboard();
     XkbGetNames(display, XkbGroupNamesMask, xkb);
 
+    /* Requests for all names are sent before waiting for replies */
+    char* names[XkbNumKbdGroups] = {NULL, };
+    /* XkbGetNames() and XGetAtomNames() */
+    x11_count_round_trip(2);
+    if(!XGetAtomNames(display, xkb->names->groups, *count, names))
+        g_warning("Layout indicator: failed to get group names");
+
     GroupInfo* groups = g_malloc(sizeof(GroupInfo)*(*count));
     for(int i = 0; i < *count; ++i)
     {
-        char* name = XGetAtomName(display, xkb->names->groups[i]);
         groups[i].group_id = i;
-        groups[i].name = g_strdup(name);
+        groups[i].name = g_strdup(names[i] ? names[i] : short_names[i]);
         groups[i].short_name = g_strdup(short_names[i]);
-        XFree(name);
+        if(names[i])
+            XFree(names[i]);
     }
     g_strfreev(short_names);
-    XFree(xkb);
+    XkbFreeKeyboard(xkb, 0, True);
     return groups;
 }
 
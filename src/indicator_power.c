@@ -25,6 +25,7 @@
 #include "shares.h"
 #include "configuration.h"
 #include "indicator_power.h"
+#include "probes.h"
 
 #ifdef _DEBUG_
 gboolean lightdm_suspend(GError** error)   { g_message("lightdm_suspend()"); return TRUE; }
@@ -37,8 +38,9 @@ gboolean lightdm_shutdown(GError** error)  { g_message("lightdm_shutdown()"); ex
 
 typedef struct
 {
-    gboolean (*get_allow)(void);
     gboolean (*do_action)(GError**);
+    /* Set by probe_power_actions() */
+    gboolean allowed;
     gboolean* show_prompt_ptr;
     const gchar* name;
     const gchar* prompt;
@@ -51,7 +53,6 @@ typedef struct
 static PowerActionData POWER_ACTIONS[POWER_ACTIONS_COUNT] =
 {
     {
-        .get_allow       = lightdm_get_can_suspend,
         .do_action       = lightdm_suspend,
         .show_prompt_ptr = &config.power.prompts[POWER_ACTION_SUSPEND],
         .name            = N_("Suspend"),
@@ -60,7 +61,6 @@ static PowerActionData POWER_ACTIONS[POWER_ACTIONS_COUNT] =
         .button_name     = "power_dialog_suspend"
     },
     {
-        .get_allow       = lightdm_get_can_hibernate,
         .do_action       = lightdm_hibernate,
         .show_prompt_ptr = &config.power.prompts[POWER_ACTION_HIBERNATE],
         .name            = N_("Hibernate"),
@@ -69,7 +69,6 @@ static PowerActionData POWER_ACTIONS[POWER_ACTIONS_COUNT] =
         .button_name     = "power_dialog_hibernate"
     },
     {
-        .get_allow       = lightdm_get_can_restart,
         .do_action       = lightdm_restart,
         .show_prompt_ptr = &config.power.prompts[POWER_ACTION_RESTART],
         .name            = N_("Restart"),
@@ -78,7 +77,6 @@ static PowerActionData POWER_ACTIONS[POWER_ACTIONS_COUNT] =
         .button_name     = "power_dialog_restart"
     },
     {
-        .get_allow       = lightdm_get_can_shutdown,
         .do_action       = lightdm_shutdown,
         .show_prompt_ptr = &config.power.prompts[POWER_ACTION_SHUTDOWN],
         .name            = N_("Shutdown"),
@@ -88,6 +86,14 @@ static PowerActionData POWER_ACTIONS[POWER_ACTIONS_COUNT] =
     }
 };
 
+static struct
+{
+    /* Action dispatched to LightDM and not finished yet */
+    const PowerActionData* pending;
+    /* Confirmation message is shown */
+    gboolean confirming;
+} power_state;
+
 /* GUI callbacks */
 
 void on_power_suspend_activate             (GtkWidget* widget,
@@ -103,6 +109,16 @@ void on_power_shutdown_activate            (GtkWidget* widget,
 /* Static functions */
 
 static void power_action(const PowerActionData* action);
+static void set_pending_action(const PowerActionData* action);
+static void power_action_thread(GTask* task,
+                                gpointer source_object,
+                                const PowerActionData* action,
+                                GCancellable* cancellable);
+static void on_power_action_finished(GObject* source_object,
+                                     GAsyncResult* result,
+                                     const PowerActionData* action);
+static void on_power_actions_probed(const gboolean* allowed,
+                                    gpointer data);
 
 /* ------------------------------------------------------------------------- *
  * Definitions: public
@@ -110,20 +126,10 @@ static void power_action(const PowerActionData* action);
 
 void init_power_indicator(void)
 {
-    gboolean allow_any = FALSE;
-    for(int i = 0; i < POWER_ACTIONS_COUNT; ++i)
-    {
-        gtk_widget_set_visible(greeter.ui.power.actions_box[i],
-                               POWER_ACTIONS[i].get_allow() && config.power.enabled);
-        allow_any |= POWER_ACTIONS[i].get_allow();
-    }
-
-    if(!config.power.enabled || !allow_any)
-    {
-        if(!allow_any)
-            g_warning("Power menu: no actions allowed, hiding widget");
-        gtk_widget_hide(greeter.ui.power.box);
-    }
+    /* Menu is shown when allowed actions are known, see on_power_actions_probed() */
+    gtk_widget_hide(greeter.ui.power.box);
+    if(config.power.enabled)
+        probe_power_actions(on_power_actions_probed, NULL);
 }
 
 void do_power_action(PowerAction action)
@@ -138,7 +144,15 @@ void do_power_action(PowerAction action)
 
 static void power_action(const PowerActionData* action)
 {
-    g_return_if_fail(config.power.enabled && action->get_allow());
+    g_return_if_fail(config.power.enabled && action->allowed);
+
+    /* Repeated requests (menu, power button) are dropped until current one is finished */
+    if(power_state.confirming || power_state.pending)
+    {
+        g_message("Action \"%s\" ignored: another action is in progress", action->name);
+        return;
+    }
+
     if(*action->show_prompt_ptr)
     {
         const MessageButtonOptions buttons[] =
@@ -147,13 +161,59 @@ static void power_action(const PowerActionData* action)
             {.id = GTK_RESPONSE_YES,    .text = g_dgettext("gtk30", "_Yes"), .name = action->button_name},
             {.id = GTK_RESPONSE_NONE}
         };
-        if(show_message(_(action->name), "%s", action->icon, buttons,
-                        GTK_RESPONSE_CANCEL, GTK_RESPONSE_CANCEL, _(action->prompt)) != GTK_RESPONSE_YES)
+        power_state.confirming = TRUE;
+        gint response = show_message(_(action->name), "%s", action->icon, buttons,
+                                     GTK_RESPONSE_CANCEL, GTK_RESPONSE_CANCEL, _(action->prompt));
+        power_state.confirming = FALSE;
+        if(response != GTK_RESPONSE_YES)
             return;
     }
 
+    /* LightDM calls logind/ConsoleKit synchronously, it can take a while */
+    set_pending_action(action);
+    GTask* task = g_task_new(NULL, NULL, (GAsyncReadyCallback)on_power_action_finished, (gpointer)action);
+    g_task_set_task_data(task, (gpointer)action, NULL);
+    g_task_run_in_thread(task, (GTaskThreadFunc)power_action_thread);
+    g_object_unref(task);
+}
+
+static void set_pending_action(const PowerActionData* action)
+{
+    power_state.pending = action;
+    if(!greeter.ui.power.widget)
+        return;
+
+    GtkStyleContext* style = gtk_widget_get_style_context(greeter.ui.power.widget);
+    if(action)
+        gtk_style_context_add_class(style, "pending");
+    else
+        gtk_style_context_remove_class(style, "pending");
+    gtk_widget_set_sensitive(greeter.ui.power.widget, action == NULL);
+}
+
+static void power_action_thread(GTask* task,
+                                gpointer source_object,
+                                const PowerActionData* action,
+                                GCancellable* cancellable)
+{
+    GError* error = NULL;
+    if(action->do_action(&error))
+        g_task_return_boolean(task, TRUE);
+    else if(error)
+        g_task_return_error(task, error);
+    else
+        g_task_return_boolean(task, FALSE);
+}
+
+static void on_power_action_finished(GObject* source_object,
+                                     GAsyncResult* result,
+                                     const PowerActionData* action)
+{
     GError* error = NULL;
-    if(!action->do_action(&error) && error)
+    g_task_propagate_boolean(G_TASK(result), &error);
+    set_pending_action(NULL);
+
+    if(error)
     {
         g_warning("Action \"%s\" failed with error: %s.", action->name, error->message);
         show_message_dialog(GTK_MESSAGE_ERROR, _(action->name),
@@ -162,6 +222,23 @@ static void power_action(const PowerActionData* action)
     }
 }
 
+static void on_power_actions_probed(const gboolean* allowed,
+                                    gpointer data)
+{
+    gboolean allow_any = FALSE;
+    for(int i = 0; i < POWER_ACTIONS_COUNT; ++i)
+    {
+        POWER_ACTIONS[i].allowed = allowed[i];
+        gtk_widget_set_visible(greeter.ui.power.actions_box[i], allowed[i]);
+        allow_any |= allowed[i];
+    }
+
+    if(allow_any)
+        gtk_widget_show(greeter.ui.power.box);
+    else
+        g_warning("Power menu: no actions allowed, hiding widget");
+}
+
 /* ------------------------------------------------------------------------- *
  * Definitions: exported
  * ------------------------------------------------------------------------- */
@@ -26,29 +26,233 @@
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <X11/Xatom.h>
 #include <lightdm.h>
 
 #include "shares.h"
 #include "composite_widgets.h"
 #include "configuration.h"
+#include "catalog.h"
 #include "indicator_power.h"
 #include "indicator_a11y.h"
 #include "indicator_clock.h"
 #include "indicator_layout.h"
 #include "model_menu.h"
 #include "model_listbox.h"
+#include "warmup.h"
+#include "readahead.h"
+#include "x11_utils.h"
+#include "watchdog.h"
+#include "metrics.h"
+#include "idle.h"
+
+/* Types */
+
+typedef struct _UserRowInfo UserRowInfo;
+
+struct _UserRowInfo
+{
+    gchar*               name;
+    /* Display name as reported by LightDM, key in greeter.state.users_display_names */
+    gchar*               display_name;
+    /* Other users with same display name, linked list starts in greeter.state.users_display_names */
+    UserRowInfo*         prev_same_name;
+    UserRowInfo*         next_same_name;
+    /* Row in users_model, GtkListStore iters persist while row exists */
+    GtkTreeIter          iter;
+
+    /* Identity of the last loaded image file, used to skip unchanged avatars */
+    struct
+    {
+        gchar*           path;
+        guint64          inode;
+        gint64           mtime;
+        gint64           size;
+        /* Incremented for every reload request, outdated results are dropped */
+        guint            serial;
+    } image;
+};
+
+typedef struct
+{
+    gchar*               user_name;
+    gchar*               image_file;
+    guint                serial;
+    /* Default images and sizes are copied on main thread, worker must not read greeter.state */
+    gint                 user_image_size;
+    gint                 list_image_size;
+    GdkPixbuf*           user_image;
+    GdkPixbuf*           list_image;
+} UserImageLoadData;
+
+typedef struct
+{
+    /* Screenshot image, converted and saved in worker thread */
+    cairo_surface_t*     image;
+    gchar*               file_path;
+    gint64               started;
+} ScreenshotData;
+
+typedef struct
+{
+    /* Place to store widget reference */
+    GtkWidget**  pwidget;
+    /* Widget ID in .ui file */
+    const gchar* name;
+    GtkWidget**  default_widget;
+    /* Part of UI that contains widget */
+    UIFragment   fragment;
+} BuilderWidget;
+
+typedef struct
+{
+    gchar**      ui_file;
+    /* Top level widget of fragment, attached to screen_layout */
+    GtkWidget**  root;
+    gint         row;
+} UIFragmentInfo;
+
+/* Static constants */
+
+/* Number of recent users stored in state file even if recent-users-limit is lower */
+static const gint RECENT_USERS_MIN_HISTORY = 16;
+/* Seconds after showing main window when startup is considered finished (lazy loading is done) */
+static const guint STARTUP_FINISHED_DELAY = 3;
+/* Seconds to show "screenshot saved" notification */
+static const guint SCREENSHOT_MESSAGE_TIMEOUT = 5;
+
+static const BuilderWidget WIDGETS[] =
+{
+    {&greeter.ui.screen_window,             "screen_window",                NULL},
+    {&greeter.ui.screen_layout,             "screen_layout",                NULL},
+
+    {&greeter.ui.main_content,              "main_content",                 NULL},
+    {&greeter.ui.main_layout,               "main_layout",                  &greeter.ui.main_content},
+    {&greeter.ui.panel_content,             "panel_content",                NULL},
+    {&greeter.ui.panel_layout,              "panel_layout",                 &greeter.ui.panel_content},
+    {&greeter.ui.panel_menubar,             "panel_menubar",                NULL},
+    {&greeter.ui.onboard_content,           "onboard_content",              NULL, UI_FRAGMENT_ONBOARD},
+    {&greeter.ui.onboard_layout,            "onboard_layout",               &greeter.ui.onboard_content, UI_FRAGMENT_ONBOARD},
+    {&greeter.ui.messagebox_content,        "messagebox_content",           NULL, UI_FRAGMENT_MESSAGEBOX},
+    {&greeter.ui.messagebox_layout,         "messagebox_layout",            &greeter.ui.messagebox_content, UI_FRAGMENT_MESSAGEBOX},
+    {&greeter.ui.messagebox_title,          "messagebox_title",             NULL, UI_FRAGMENT_MESSAGEBOX},
+    {&greeter.ui.messagebox_text,           "messagebox_text",              NULL, UI_FRAGMENT_MESSAGEBOX},
+    {&greeter.ui.messagebox_buttons,        "messagebox_buttons",           NULL, UI_FRAGMENT_MESSAGEBOX},
+    {&greeter.ui.messagebox_icon,           "messagebox_icon",              NULL, UI_FRAGMENT_MESSAGEBOX},
+
+    {&greeter.ui.login_widget,              "login_widget",                 NULL},
+    {&greeter.ui.login_label,               "login_label",                  &greeter.ui.login_widget},
+    {&greeter.ui.login_box,                 "login_box",                    &greeter.ui.login_widget},
+
+    {&greeter.ui.no_prompt_login_widget,    "no_prompt_login_widget",       NULL},
+    {&greeter.ui.no_prompt_login_label,     "no_prompt_login_label",        &greeter.ui.no_prompt_login_widget},
+    {&greeter.ui.no_prompt_login_box,       "no_prompt_login_box",          &greeter.ui.no_prompt_login_widget},
+
+    {&greeter.ui.cancel_widget,             "cancel_widget",                NULL},
+    {&greeter.ui.cancel_box,                "cancel_box",                   &greeter.ui.cancel_widget},
+
+    {&greeter.ui.message_widget,            "message_widget",               NULL},
+    {&greeter.ui.message_box,               "message_box",                  &greeter.ui.message_widget},
+
+    {&greeter.ui.prompt_entry,              "prompt_entry",                 NULL},
+    {&greeter.ui.prompt_text,               "prompt_text",                  NULL},
+    {&greeter.ui.prompt_box,                "prompt_box",                   NULL},
+
+    {&greeter.ui.authentication_widget,     "authentication_widget",        NULL},
+    {&greeter.ui.authentication_box,        "authentication_box",           &greeter.ui.authentication_widget},
+
+    {&greeter.ui.users_widget,              "users_widget",                 NULL},
+    {&greeter.ui.users_text,                "users_text",                   &greeter.ui.users_widget},
+    {&greeter.ui.users_box,                 "users_box",                    &greeter.ui.users_widget},
+    {(GtkWidget**)(&greeter.ui.users_model),"users_model",                  NULL},
+
+    {&greeter.ui.sessions_widget,           "sessions_widget",              NULL},
+    {&greeter.ui.sessions_text,             "sessions_text",                &greeter.ui.sessions_widget},
+    {&greeter.ui.sessions_box,              "sessions_box",                 &greeter.ui.sessions_widget},
+    {(GtkWidget**)(&greeter.ui.sessions_model), "sessions_model",           NULL},
+
+    {&greeter.ui.languages_widget,          "languages_widget",             NULL},
+    {&greeter.ui.languages_text,            "languages_text",               &greeter.ui.languages_widget},
+    {&greeter.ui.languages_box,             "languages_box",                &greeter.ui.languages_widget},
+    {(GtkWidget**)(&greeter.ui.languages_model), "languages_model",         NULL},
+
+    {&greeter.ui.user_image_widget,         "user_image_widget",            NULL},
+    {&greeter.ui.user_image_box,            "user_image_box",               &greeter.ui.user_image_widget},
+
+    {&greeter.ui.date_widget,               "date_widget",                  NULL},
+    {&greeter.ui.date_box,                  "date_box",                     &greeter.ui.date_widget},
+
+    {&greeter.ui.host_widget,               "host_widget",                  NULL},
+    {&greeter.ui.host_box,                  "host_box",                     &greeter.ui.host_widget},
+
+    {&greeter.ui.logo_image_widget,         "logo_image_widget",            NULL},
+    {&greeter.ui.logo_image_box,            "logo_image_box",               &greeter.ui.logo_image_widget},
+
+    {&greeter.ui.power.widget,              "power_widget",                 NULL},
+    {&greeter.ui.power.box,                 "power_box",                    &greeter.ui.power.widget},
+    {&greeter.ui.power.menu,                "power_menu",                   NULL},
+    {&greeter.ui.power.actions[POWER_ACTION_SUSPEND],  "power_suspend_widget",     NULL},
+    {&greeter.ui.power.actions[POWER_ACTION_HIBERNATE],"power_hibernate_widget",   NULL},
+    {&greeter.ui.power.actions[POWER_ACTION_RESTART],  "power_restart_widget",     NULL},
+    {&greeter.ui.power.actions[POWER_ACTION_SHUTDOWN], "power_shutdown_widget",    NULL},
+    {&greeter.ui.power.actions_box[POWER_ACTION_SUSPEND],  "power_suspend_box",    &greeter.ui.power.actions[POWER_ACTION_SUSPEND]},
+    {&greeter.ui.power.actions_box[POWER_ACTION_HIBERNATE],"power_hibernate_box",  &greeter.ui.power.actions[POWER_ACTION_HIBERNATE]},
+    {&greeter.ui.power.actions_box[POWER_ACTION_RESTART],  "power_restart_box",    &greeter.ui.power.actions[POWER_ACTION_RESTART]},
+    {&greeter.ui.power.actions_box[POWER_ACTION_SHUTDOWN], "power_shutdown_box",   &greeter.ui.power.actions[POWER_ACTION_SHUTDOWN]},
+
+    {&greeter.ui.a11y.widget,               "a11y_widget",                  NULL},
+    {&greeter.ui.a11y.box,                  "a11y_box",                     &greeter.ui.a11y.widget},
+    {&greeter.ui.a11y.menu,                 "a11y_menu",                    NULL},
+    {&greeter.ui.a11y.osk_widget,           "a11y_osk_widget",              NULL},
+    {&greeter.ui.a11y.osk_box,              "a11y_osk_box",                 &greeter.ui.a11y.osk_widget},
+    {&greeter.ui.a11y.contrast_widget,      "a11y_contrast_widget",         NULL},
+    {&greeter.ui.a11y.contrast_box,         "a11y_contrast_box",            &greeter.ui.a11y.contrast_widget},
+    {&greeter.ui.a11y.font_widget,          "a11y_font_widget",             NULL},
+    {&greeter.ui.a11y.font_box,             "a11y_font_box",                &greeter.ui.a11y.font_widget},
+    {&greeter.ui.a11y.dpi_widget,           "a11y_dpi_widget",              NULL},
+    {&greeter.ui.a11y.dpi_box,              "a11y_dpi_box",                 &greeter.ui.a11y.dpi_widget},
+
+    {&greeter.ui.clock.time_widget,         "clock_time_widget",            NULL},
+    {&greeter.ui.clock.time_box,            "clock_time_box",               &greeter.ui.clock.time_widget},
+    {&greeter.ui.clock.time_menu,           "clock_time_menu",              NULL},
+    {&greeter.ui.clock.date_widget,         "clock_date_widget",            NULL},
+    {&greeter.ui.clock.date_box,            "clock_date_box",               &greeter.ui.clock.date_widget},
+
+    {&greeter.ui.layout.widget,             "layout_widget",                NULL},
+    {&greeter.ui.layout.box,                "layout_box",                   &greeter.ui.layout.widget},
+    {&greeter.ui.layout.menu,               "layout_menu",                  NULL},
+
+    {&greeter.ui.password_toggle_widget,    "password_toggle_widget",       NULL},
+    {&greeter.ui.password_toggle_box,       "password_toggle_box",          &greeter.ui.password_toggle_widget},
+    {NULL, NULL, NULL}
+};
+
+/* Messagebox shares cell with main_layout, as in greeter.ui before it was split: only one of them is shown */
+static const UIFragmentInfo UI_FRAGMENTS[UI_FRAGMENTS_COUNT] =
+{
+    [UI_FRAGMENT_MAIN]       = {&config.appearance.ui_file,            &greeter.ui.screen_layout,     -1},
+    [UI_FRAGMENT_MESSAGEBOX] = {&config.appearance.messagebox_ui_file, &greeter.ui.messagebox_layout, UI_LAYOUT_ROW_MAIN},
+    [UI_FRAGMENT_ONBOARD]    = {&config.appearance.onboard_ui_file,    &greeter.ui.onboard_layout,    UI_LAYOUT_ROW_ONBOARD_BOTTOM}
+};
 
 /* Static functions */
 
 static gboolean connect_to_lightdm          (void);
 static gboolean init_gui                    (void);
+static GtkBuilder* build_ui_file            (const gchar* path,
+                                             GError** error);
+static void bind_ui_widgets                 (GtkBuilder* builder,
+                                             UIFragment fragment);
 static void run_gui                         (void);
 static void close_gui                       (void);
 
 static gboolean load_users_list             (void);
 static void load_sessions_list              (void);
+static void on_session_images_ready         (void);
 static gboolean load_languages_list         (void);
+static gboolean load_lists_idle             (gpointer dummy);
+static gboolean on_startup_finished         (gpointer dummy);
 
 static void init_user_selection             (void);
 static void load_user_options               (LightDMUser* user);
@@ -61,14 +265,26 @@ static void set_logo_image                  (void);
 static void set_message_text                (const gchar* text);
 static void set_prompt_text                 (const gchar* text);
 static void set_login_button_state          (gboolean logged);
-static gboolean update_date_label           (gpointer dummy);
 static void set_login_button_width          (void);
 
 static void take_screenshot                 (void);
+static void free_screenshot_data            (ScreenshotData* data);
+static void save_screenshot_thread          (GTask* task,
+                                             gpointer source_object,
+                                             ScreenshotData* data,
+                                             GCancellable* cancellable);
+static void on_screenshot_saved             (GObject* source_object,
+                                             GAsyncResult* result,
+                                             gpointer user_data);
+static gboolean on_screenshot_message_timeout (gpointer data);
 
 static void start_authentication            (const gchar* username);
 static void cancel_authentication           (void);
 static void start_session                   (void);
+static void on_session_started              (GObject* source_object,
+                                             GAsyncResult* result,
+                                             gpointer data);
+static void set_session_starting            (gboolean starting);
 
 static gchar* get_user_name                 (void);
 static UserType get_user_type               (void);
@@ -151,6 +367,28 @@ int main(int argc, char** argv)
     GREETER_DATA_DIR = g_build_filename(g_get_current_dir(), GREETER_DATA_DIR, NULL);
     #endif
 
+    gboolean dump_metrics = FALSE;
+    const GOptionEntry OPTIONS[] =
+    {
+        {"auth-metrics", 0, 0, G_OPTION_ARG_NONE, &dump_metrics,
+         "Print authentication latency percentiles and exit", NULL},
+        {NULL}
+    };
+    GOptionContext* options = g_option_context_new(NULL);
+    g_option_context_add_main_entries(options, OPTIONS, NULL);
+    /* Gtk options are parsed by gtk_init() */
+    g_option_context_set_ignore_unknown_options(options, TRUE);
+    g_option_context_set_help_enabled(options, FALSE);
+    g_option_context_parse(options, &argc, &argv, NULL);
+    g_option_context_free(options);
+    if(dump_metrics)
+    {
+        metrics_dump();
+        return EXIT_SUCCESS;
+    }
+
+    readahead_replay();
+
     g_message("Another GTK+ Greeter version %s", PACKAGE_VERSION);
     signal(SIGTERM, on_sigterm_signal);
 
@@ -160,8 +398,12 @@ int main(int argc, char** argv)
     bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
 
     gtk_init(&argc, &argv);
+    x11_init();
+    x11_phase_begin("Startup");
 
     load_settings();
+    start_watchdog();
+    start_warmup();
     read_state();
 
     gboolean inited = connect_to_lightdm();
@@ -232,8 +474,8 @@ static gboolean init_gui(void)
     g_message("Loading UI file: %s", config.appearance.ui_file);
 
     GError* error = NULL;
-    GtkBuilder* builder = gtk_builder_new();
-    if(!gtk_builder_add_from_file(builder, config.appearance.ui_file, &error))
+    GtkBuilder* builder = build_ui_file(config.appearance.ui_file, &error);
+    if(!builder)
     {
         show_message_dialog(GTK_MESSAGE_ERROR, _("Error"),
                             _("Error loading UI file:\n\n%s"), error->message);
@@ -242,148 +484,7 @@ static gboolean init_gui(void)
         return FALSE;
     }
 
-    struct BuilderWidget
-    {
-        /* Place to store widget reference */
-        GtkWidget**  pwidget;
-        /* Widget ID in .ui file */
-        const gchar* name;
-        GtkWidget**  default_widget;
-    };
-
-    const struct BuilderWidget WIDGETS[] =
-    {
-        {&greeter.ui.screen_window,             "screen_window",                NULL},
-        {&greeter.ui.screen_layout,             "screen_layout",                NULL},
-
-        {&greeter.ui.main_content,              "main_content",                 NULL},
-        {&greeter.ui.main_layout,               "main_layout",                  &greeter.ui.main_content},
-        {&greeter.ui.panel_content,             "panel_content",                NULL},
-        {&greeter.ui.panel_layout,              "panel_layout",                 &greeter.ui.panel_content},
-        {&greeter.ui.panel_menubar,             "panel_menubar",                NULL},
-        {&greeter.ui.onboard_content,           "onboard_content",              NULL},
-        {&greeter.ui.onboard_layout,            "onboard_layout",               &greeter.ui.onboard_content},
-        {&greeter.ui.messagebox_content,        "messagebox_content",           NULL},
-        {&greeter.ui.messagebox_layout,         "messagebox_layout",            &greeter.ui.messagebox_content},
-        {&greeter.ui.messagebox_title,          "messagebox_title",             NULL},
-        {&greeter.ui.messagebox_text,           "messagebox_text",              NULL},
-        {&greeter.ui.messagebox_buttons,        "messagebox_buttons",           NULL},
-        {&greeter.ui.messagebox_icon,           "messagebox_icon",              NULL},
-
-        {&greeter.ui.login_widget,              "login_widget",                 NULL},
-        {&greeter.ui.login_label,               "login_label",                  &greeter.ui.login_widget},
-        {&greeter.ui.login_box,                 "login_box",                    &greeter.ui.login_widget},
-
-        {&greeter.ui.no_prompt_login_widget,    "no_prompt_login_widget",       NULL},
-        {&greeter.ui.no_prompt_login_label,     "no_prompt_login_label",        &greeter.ui.no_prompt_login_widget},
-        {&greeter.ui.no_prompt_login_box,       "no_prompt_login_box",          &greeter.ui.no_prompt_login_widget},
-
-        {&greeter.ui.cancel_widget,             "cancel_widget",                NULL},
-        {&greeter.ui.cancel_box,                "cancel_box",                   &greeter.ui.cancel_widget},
-
-        {&greeter.ui.message_widget,            "message_widget",               NULL},
-        {&greeter.ui.message_box,               "message_box",                  &greeter.ui.message_widget},
-
-        {&greeter.ui.prompt_entry,              "prompt_entry",                 NULL},
-        {&greeter.ui.prompt_text,               "prompt_text",                  NULL},
-        {&greeter.ui.prompt_box,                "prompt_box",                   NULL},
-
-        {&greeter.ui.authentication_widget,     "authentication_widget",        NULL},
-        {&greeter.ui.authentication_box,        "authentication_box",           &greeter.ui.authentication_widget},
-
-        {&greeter.ui.users_widget,              "users_widget",                 NULL},
-        {&greeter.ui.users_text,                "users_text",                   &greeter.ui.users_widget},
-        {&greeter.ui.users_box,                 "users_box",                    &greeter.ui.users_widget},
-        {(GtkWidget**)(&greeter.ui.users_model),"users_model",                  NULL},
-
-        {&greeter.ui.sessions_widget,           "sessions_widget",              NULL},
-        {&greeter.ui.sessions_text,             "sessions_text",                &greeter.ui.sessions_widget},
-        {&greeter.ui.sessions_box,              "sessions_box",                 &greeter.ui.sessions_widget},
-        {(GtkWidget**)(&greeter.ui.sessions_model), "sessions_model",           NULL},
-
-        {&greeter.ui.languages_widget,          "languages_widget",             NULL},
-        {&greeter.ui.languages_text,            "languages_text",               &greeter.ui.languages_widget},
-        {&greeter.ui.languages_box,             "languages_box",                &greeter.ui.languages_widget},
-        {(GtkWidget**)(&greeter.ui.languages_model), "languages_model",         NULL},
-
-        {&greeter.ui.user_image_widget,         "user_image_widget",            NULL},
-        {&greeter.ui.user_image_box,            "user_image_box",               &greeter.ui.user_image_widget},
-
-        {&greeter.ui.date_widget,               "date_widget",                  NULL},
-        {&greeter.ui.date_box,                  "date_box",                     &greeter.ui.date_widget},
-
-        {&greeter.ui.host_widget,               "host_widget",                  NULL},
-        {&greeter.ui.host_box,                  "host_box",                     &greeter.ui.host_widget},
-
-        {&greeter.ui.logo_image_widget,         "logo_image_widget",            NULL},
-        {&greeter.ui.logo_image_box,            "logo_image_box",               &greeter.ui.logo_image_widget},
-
-        {&greeter.ui.power.widget,              "power_widget",                 NULL},
-        {&greeter.ui.power.box,                 "power_box",                    &greeter.ui.power.widget},
-        {&greeter.ui.power.menu,                "power_menu",                   NULL},
-        {&greeter.ui.power.actions[POWER_ACTION_SUSPEND],  "power_suspend_widget",     NULL},
-        {&greeter.ui.power.actions[POWER_ACTION_HIBERNATE],"power_hibernate_widget",   NULL},
-        {&greeter.ui.power.actions[POWER_ACTION_RESTART],  "power_restart_widget",     NULL},
-        {&greeter.ui.power.actions[POWER_ACTION_SHUTDOWN], "power_shutdown_widget",    NULL},
-        {&greeter.ui.power.actions_box[POWER_ACTION_SUSPEND],  "power_suspend_box",    &greeter.ui.power.actions[POWER_ACTION_SUSPEND]},
-        {&greeter.ui.power.actions_box[POWER_ACTION_HIBERNATE],"power_hibernate_box",  &greeter.ui.power.actions[POWER_ACTION_HIBERNATE]},
-        {&greeter.ui.power.actions_box[POWER_ACTION_RESTART],  "power_restart_box",    &greeter.ui.power.actions[POWER_ACTION_RESTART]},
-        {&greeter.ui.power.actions_box[POWER_ACTION_SHUTDOWN], "power_shutdown_box",   &greeter.ui.power.actions[POWER_ACTION_SHUTDOWN]},
-
-        {&greeter.ui.a11y.widget,               "a11y_widget",                  NULL},
-        {&greeter.ui.a11y.box,                  "a11y_box",                     &greeter.ui.a11y.widget},
-        {&greeter.ui.a11y.menu,                 "a11y_menu",                    NULL},
-        {&greeter.ui.a11y.osk_widget,           "a11y_osk_widget",              NULL},
-        {&greeter.ui.a11y.osk_box,              "a11y_osk_box",                 &greeter.ui.a11y.osk_widget},
-        {&greeter.ui.a11y.contrast_widget,      "a11y_contrast_widget",         NULL},
-        {&greeter.ui.a11y.contrast_box,         "a11y_contrast_box",            &greeter.ui.a11y.contrast_widget},
-        {&greeter.ui.a11y.font_widget,          "a11y_font_widget",             NULL},
-        {&greeter.ui.a11y.font_box,             "a11y_font_box",                &greeter.ui.a11y.font_widget},
-        {&greeter.ui.a11y.dpi_widget,           "a11y_dpi_widget",              NULL},
-        {&greeter.ui.a11y.dpi_box,              "a11y_dpi_box",                 &greeter.ui.a11y.dpi_widget},
-
-        {&greeter.ui.clock.time_widget,         "clock_time_widget",            NULL},
-        {&greeter.ui.clock.time_box,            "clock_time_box",               &greeter.ui.clock.time_widget},
-        {&greeter.ui.clock.time_menu,           "clock_time_menu",              NULL},
-        {&greeter.ui.clock.date_widget,         "clock_date_widget",            NULL},
-        {&greeter.ui.clock.date_box,            "clock_date_box",               &greeter.ui.clock.date_widget},
-
-        {&greeter.ui.layout.widget,             "layout_widget",                NULL},
-        {&greeter.ui.layout.box,                "layout_box",                   &greeter.ui.layout.widget},
-        {&greeter.ui.layout.menu,               "layout_menu",                  NULL},
-
-        {&greeter.ui.password_toggle_widget,    "password_toggle_widget",       NULL},
-        {&greeter.ui.password_toggle_box,       "password_toggle_box",          &greeter.ui.password_toggle_widget},
-        {NULL, NULL, FALSE}
-    };
-
-    for(const struct BuilderWidget* w = WIDGETS; w->pwidget != NULL; ++w)
-    {
-        *w->pwidget = GTK_WIDGET(gtk_builder_get_object(builder, w->name));
-        if(!*w->pwidget && w->default_widget)
-            *w->pwidget = *w->default_widget;
-        if(*w->pwidget)
-        {
-            if(GTK_IS_IMAGE_MENU_ITEM(*w->pwidget) &&
-               gtk_image_menu_item_get_image(GTK_IMAGE_MENU_ITEM(*w->pwidget)))
-                fix_image_menu_item_if_empty(GTK_IMAGE_MENU_ITEM(*w->pwidget));
-        }
-        else
-        {
-            g_warning("Widget is not found: %s", w->name);
-        }
-    }
-
-    void update_widget_name(GObject* object,
-                            gpointer nothing)
-    {
-        if(GTK_IS_WIDGET(object))
-            gtk_widget_set_name(GTK_WIDGET(object), gtk_buildable_get_name(GTK_BUILDABLE(object)));
-    }
-
-    GSList* builder_widgets = gtk_builder_get_objects(builder);
-    g_slist_foreach(builder_widgets, (GFunc)update_widget_name, NULL);
-    g_slist_free(builder_widgets);
+    bind_ui_widgets(builder, UI_FRAGMENT_MAIN);
 
     /* Disabling system F10 hotkey */
     g_object_set(gtk_settings_get_default(), "gtk-menu-bar-accel", NULL, NULL);
@@ -471,11 +572,10 @@ static gboolean init_gui(void)
 
     update_default_user_image();
 
-    if(!load_languages_list() || !config.greeter.show_language_selector)
+    /* Sessions and languages lists are loaded after first frame, see load_lists_idle() */
+    if(!config.greeter.show_language_selector)
         gtk_widget_hide(greeter.ui.languages_box);
 
-    load_sessions_list();
-
     greeter.state.no_users_list = lightdm_greeter_get_hide_users_hint(greeter.greeter) ||
                                   !greeter.ui.users_widget;
     if(greeter.state.no_users_list)
@@ -498,35 +598,135 @@ static gboolean init_gui(void)
     else
         gtk_widget_hide(greeter.ui.panel_layout);
 
-    gtk_widget_hide(greeter.ui.onboard_layout);
-    gtk_widget_hide(greeter.ui.messagebox_layout);
+    /* Fragments built later are hidden by load_ui_fragment() */
+    if(greeter.ui.onboard_layout)
+        gtk_widget_hide(greeter.ui.onboard_layout);
+    if(greeter.ui.messagebox_layout)
+        gtk_widget_hide(greeter.ui.messagebox_layout);
 
     gtk_builder_connect_signals(builder, greeter.greeter);
 
     return TRUE;
 }
 
+static GtkBuilder* build_ui_file(const gchar* path,
+                                 GError** error)
+{
+    GtkBuilder* builder = gtk_builder_new();
+    gchar* bundled_path = get_bundled_path(path);
+    readahead_note_file(bundled_path ? NULL : path);
+    gboolean loaded = bundled_path ? gtk_builder_add_from_resource(builder, bundled_path, error)
+                                   : gtk_builder_add_from_file(builder, path, error);
+    g_free(bundled_path);
+    if(!loaded)
+        g_clear_object(&builder);
+    return builder;
+}
+
+static void bind_ui_widgets(GtkBuilder* builder,
+                            UIFragment fragment)
+{
+    for(const BuilderWidget* w = WIDGETS; w->pwidget != NULL; ++w)
+    {
+        /* Main UI file may contain any fragment, fragment file contains only its own widgets */
+        if(*w->pwidget || (fragment != UI_FRAGMENT_MAIN && w->fragment != fragment))
+            continue;
+        *w->pwidget = GTK_WIDGET(gtk_builder_get_object(builder, w->name));
+        if(!*w->pwidget && w->default_widget)
+            *w->pwidget = *w->default_widget;
+        if(*w->pwidget)
+        {
+            if(GTK_IS_IMAGE_MENU_ITEM(*w->pwidget) &&
+               gtk_image_menu_item_get_image(GTK_IMAGE_MENU_ITEM(*w->pwidget)))
+                fix_image_menu_item_if_empty(GTK_IMAGE_MENU_ITEM(*w->pwidget));
+        }
+        else if(w->fragment == fragment)
+        {
+            g_warning("Widget is not found: %s", w->name);
+        }
+    }
+
+    void update_widget_name(GObject* object,
+                            gpointer nothing)
+    {
+        if(GTK_IS_WIDGET(object))
+            gtk_widget_set_name(GTK_WIDGET(object), gtk_buildable_get_name(GTK_BUILDABLE(object)));
+    }
+
+    GSList* builder_widgets = gtk_builder_get_objects(builder);
+    g_slist_foreach(builder_widgets, (GFunc)update_widget_name, NULL);
+    g_slist_free(builder_widgets);
+}
+
+gboolean load_ui_fragment(UIFragment fragment)
+{
+    const UIFragmentInfo* info = &UI_FRAGMENTS[fragment];
+    if(*info->root)
+        return TRUE;
+
+    const gchar* ui_file = *info->ui_file;
+    if(!ui_file)
+        return FALSE;
+
+    g_message("Loading UI fragment: %s", ui_file);
+
+    GError* error = NULL;
+    GtkBuilder* builder = build_ui_file(ui_file, &error);
+    if(!builder)
+    {
+        g_warning("Error loading UI fragment: %s", error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+
+    bind_ui_widgets(builder, fragment);
+    if(*info->root)
+    {
+        gtk_grid_attach(GTK_GRID(greeter.ui.screen_layout), *info->root, 0, info->row, UI_LAYOUT_WIDTH, 1);
+        gtk_widget_hide(*info->root);
+        gtk_builder_connect_signals(builder, greeter.greeter);
+    }
+    else
+    {
+        /* Widgets are destroyed with builder */
+        for(const BuilderWidget* w = WIDGETS; w->pwidget != NULL; ++w)
+            if(w->fragment == fragment)
+                *w->pwidget = NULL;
+    }
+    g_object_unref(builder);
+    return *info->root != NULL;
+}
+
 static void run_gui(void)
 {
     if(config.appearance.fixed_login_button_width)
         set_login_button_width();
 
     if(greeter.ui.date_widget)
-    {
-        update_date_label(NULL);
-        g_timeout_add_seconds(1, (GSourceFunc)update_date_label, NULL);
-    }
+        clock_add_label(greeter.ui.date_widget, config.appearance.date_format);
 
     on_screen_changed(greeter.ui.screen_window, NULL, FALSE);
     init_user_selection();
     gtk_widget_show(greeter.ui.screen_window);
     update_main_window_layout();
     focus_main_window();
+    init_idle_mode();
+    if(config.greeter.show_session_icon)
+        set_session_images_callback(on_session_images_ready);
+    g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)load_lists_idle, NULL, NULL);
+    g_timeout_add_seconds(STARTUP_FINISHED_DELAY, (GSourceFunc)on_startup_finished, NULL);
     if(config.appearance.background && !config.appearance.user_background)
         set_background(config.appearance.background);
+    x11_phase_end();
     gtk_main();
 }
 
+static gboolean on_startup_finished(gpointer dummy)
+{
+    readahead_record();
+    return G_SOURCE_REMOVE;
+}
+
 static void close_gui(void)
 {
     if(greeter.state.autostart_pid)
@@ -535,74 +735,227 @@ static void close_gui(void)
         g_spawn_close_pid(greeter.state.autostart_pid);
         greeter.state.autostart_pid = 0;
     }
+    free_catalogs();
+    metrics_save();
+}
+
+static gchar* get_user_display_name(const UserRowInfo* info)
+{
+    const gboolean same_names = info->prev_same_name || info->next_same_name;
+    if(config.appearance.user_name_format == USER_NAME_FORMAT_NAME)
+        return g_strdup(info->name);
+    else if(config.appearance.user_name_format == USER_NAME_FORMAT_BOTH || same_names)
+        return g_strdup_printf("%s (%s)", info->display_name, info->name);
+    else
+        return g_strdup(info->display_name);
+}
+
+/* Updates display name of user row, used when name becomes (un)ambiguous.
+   Row may be not added yet: it is filled with actual name by append_user() */
+static void update_user_row_display_name(UserRowInfo* info)
+{
+    if(!info->iter.user_data)
+        return;
+    gchar* display_name = get_user_display_name(info);
+    gtk_list_store_set(greeter.ui.users_model, &info->iter, USER_COLUMN_DISPLAY_NAME, display_name, -1);
+    g_free(display_name);
+}
+
+/* Links user to others with same display name, updates row of the only other user if name becomes ambiguous */
+static void register_user_display_name(UserRowInfo* info)
+{
+    UserRowInfo* head = g_hash_table_lookup(greeter.state.users_display_names, info->display_name);
+    info->prev_same_name = NULL;
+    info->next_same_name = head;
+    if(head)
+        head->prev_same_name = info;
+    g_hash_table_insert(greeter.state.users_display_names, g_strdup(info->display_name), info);
+    if(head && !head->next_same_name)
+        update_user_row_display_name(head);
+}
+
+/* Unlinks user from others with same display name, updates row of the last remaining user */
+static void unregister_user_display_name(UserRowInfo* info)
+{
+    UserRowInfo* prev = info->prev_same_name;
+    UserRowInfo* next = info->next_same_name;
+    if(prev)
+        prev->next_same_name = next;
+    else if(next)
+        g_hash_table_insert(greeter.state.users_display_names, g_strdup(info->display_name), next);
+    else
+        g_hash_table_remove(greeter.state.users_display_names, info->display_name);
+    if(next)
+        next->prev_same_name = prev;
+    info->prev_same_name = info->next_same_name = NULL;
+
+    UserRowInfo* other = prev ? prev : next;
+    if(other && !other->prev_same_name && !other->next_same_name)
+        update_user_row_display_name(other);
+}
+
+static void free_user_row_info(UserRowInfo* info)
+{
+    g_free(info->image.path);
+    g_free(info->name);
+    g_free(info->display_name);
+    g_free(info);
 }
 
-static gint update_users_names_table(const gchar* display_name)
+/* Loads and fits user image. *user_image and *list_image must contain default images (or NULL),
+   they are kept on failure. Returned images must be unreferenced.
+   Called from worker threads too: must not touch GTK objects and greeter.state */
+static void load_user_images(const gchar* user_name,
+                             const gchar* image_file,
+                             gint user_image_size,
+                             gint list_image_size,
+                             GdkPixbuf** user_image,
+                             GdkPixbuf** list_image)
 {
-    gint* value = g_hash_table_lookup(greeter.state.users_display_names, display_name);
-    if(!value)
+    if(!image_file || (!config.appearance.user_image.enabled && !config.appearance.list_image.enabled))
+        return;
+
+    readahead_note_file(image_file);
+    GError* error = NULL;
+    GdkPixbuf* image = gdk_pixbuf_new_from_file(image_file, &error);
+    if(!image)
+    {
+        g_warning("Failed to load user image (%s): %s", user_name, error ? error->message : "unknown error");
+        g_clear_error(&error);
+        return;
+    }
+    if(config.appearance.user_image.enabled)
+    {
+        g_clear_object(user_image);
+        *user_image = fit_image(image, user_image_size, config.appearance.user_image.fit);
+    }
+    if(config.appearance.list_image.enabled)
     {
-        value = g_malloc(sizeof(gint));
-        *value = 0;
-        g_hash_table_insert(greeter.state.users_display_names, g_strdup(display_name), value);
+        g_clear_object(list_image);
+        *list_image = fit_image(image, list_image_size, config.appearance.list_image.fit);
     }
-    return ++(*value);
+    g_object_unref(image);
+}
+
+/* Returns TRUE if image path or file (inode, mtime, size) differs from last loaded one */
+static gboolean update_user_image_identity(UserRowInfo* info,
+                                           const gchar* image_file)
+{
+    GStatBuf st;
+    guint64 inode = 0;
+    gint64 mtime = 0, size = 0;
+    if(image_file && g_stat(image_file, &st) == 0)
+    {
+        inode = st.st_ino;
+        mtime = st.st_mtime;
+        size = st.st_size;
+    }
+
+    if(g_strcmp0(info->image.path, image_file) == 0 && info->image.inode == inode &&
+       info->image.mtime == mtime && info->image.size == size)
+        return FALSE;
+
+    g_free(info->image.path);
+    info->image.path = g_strdup(image_file);
+    info->image.inode = inode;
+    info->image.mtime = mtime;
+    info->image.size = size;
+    return TRUE;
+}
+
+static void free_user_image_load_data(UserImageLoadData* data)
+{
+    g_clear_object(&data->user_image);
+    g_clear_object(&data->list_image);
+    g_free(data->user_name);
+    g_free(data->image_file);
+    g_free(data);
+}
+
+static void load_user_images_thread(GTask* task,
+                                    gpointer source_object,
+                                    UserImageLoadData* data,
+                                    GCancellable* cancellable)
+{
+    load_user_images(data->user_name, data->image_file, data->user_image_size, data->list_image_size,
+                     &data->user_image, &data->list_image);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_user_images_loaded(GObject* source_object,
+                                  GAsyncResult* result,
+                                  gpointer user_data)
+{
+    UserImageLoadData* data = g_task_get_task_data(G_TASK(result));
+    UserRowInfo* info = greeter.state.users_rows ? g_hash_table_lookup(greeter.state.users_rows, data->user_name) : NULL;
+    if(!info || info->image.serial != data->serial)
+        return;
+
+    g_debug("User image updated: %s", data->user_name);
+    gtk_list_store_set(greeter.ui.users_model, &info->iter,
+                       USER_COLUMN_USER_IMAGE, data->user_image,
+                       USER_COLUMN_LIST_IMAGE, data->list_image,
+                       -1);
+    gchar* selected_user = get_user_name();
+    if(g_strcmp0(selected_user, data->user_name) == 0)
+        update_user_image();
+    g_free(selected_user);
 }
 
-static gint get_same_name_count(const gchar* display_name)
+static void reload_user_images_async(UserRowInfo* info)
 {
-    const gint* value = g_hash_table_lookup(greeter.state.users_display_names, display_name);
-    return value ? *value : 0;
+    UserImageLoadData* data = g_malloc0(sizeof(UserImageLoadData));
+    data->user_name = g_strdup(info->name);
+    data->image_file = g_strdup(info->image.path);
+    data->serial = ++info->image.serial;
+    data->user_image_size = greeter.state.user_image.size;
+    data->list_image_size = greeter.state.list_image.size;
+    if(greeter.state.user_image.default_image)
+        data->user_image = g_object_ref(greeter.state.user_image.default_image);
+    if(greeter.state.list_image.default_image)
+        data->list_image = g_object_ref(greeter.state.list_image.default_image);
+
+    GTask* task = g_task_new(NULL, NULL, on_user_images_loaded, NULL);
+    g_task_set_task_data(task, data, (GDestroyNotify)free_user_image_load_data);
+    g_task_run_in_thread(task, (GTaskThreadFunc)load_user_images_thread);
+    g_object_unref(task);
 }
 
-static void append_user(LightDMUser* user,
-                        gboolean update_hash_table)
+static void append_user(LightDMUser* user)
 {
     const gchar* base_display_name = lightdm_user_get_display_name(user);
     const gchar* user_name = lightdm_user_get_name(user);
     const gchar* image_file = lightdm_user_get_image(user);
-    gchar* display_name = NULL;
-    GdkPixbuf* user_image = greeter.state.user_image.default_image;
-    GdkPixbuf* list_image = greeter.state.list_image.default_image;
+    GdkPixbuf* user_image = NULL;
+    GdkPixbuf* list_image = NULL;
 
     g_debug("Adding user: %s (%s)", base_display_name, user_name);
 
-    gint same_name_count = 0;
-    if(update_hash_table)
-        same_name_count = update_users_names_table(base_display_name);
-    else
-        same_name_count = get_same_name_count(base_display_name);
-
-    if(config.appearance.user_name_format == USER_NAME_FORMAT_NAME)
-        display_name = g_strdup(user_name);
-    else if(config.appearance.user_name_format == USER_NAME_FORMAT_BOTH || same_name_count > 1)
-        display_name = g_strdup_printf("%s (%s)", base_display_name, user_name);
-    else
-        display_name = g_strdup(base_display_name);
-
-    if(config.appearance.user_image.enabled ||
-       config.appearance.list_image.enabled)
+    if(g_hash_table_contains(greeter.state.users_rows, user_name))
     {
-        GError* error = NULL;
-        GdkPixbuf* image = gdk_pixbuf_new_from_file(image_file, &error);
-        if(!image)
-        {
-            g_warning("Failed to load user image (%s): %s", user_name, error->message);
-            g_clear_error(&error);
-        }
-        else
-        {
-            if(config.appearance.user_image.enabled)
-                user_image = fit_image(image, greeter.state.user_image.size, config.appearance.user_image.fit);
-            if(config.appearance.list_image.enabled)
-                list_image = fit_image(image, greeter.state.list_image.size, config.appearance.list_image.fit);
-            g_object_unref(image);
-        }
+        g_warning("User is already in the list: %s", user_name);
+        return;
     }
 
-    GtkTreeIter iter;
-    gtk_list_store_append(greeter.ui.users_model, &iter);
-    gtk_list_store_set(greeter.ui.users_model, &iter,
+    UserRowInfo* info = g_malloc0(sizeof(UserRowInfo));
+    info->name = g_strdup(user_name);
+    info->display_name = g_strdup(base_display_name);
+    register_user_display_name(info);
+    gchar* display_name = get_user_display_name(info);
+
+    if(greeter.state.user_image.default_image)
+        user_image = g_object_ref(greeter.state.user_image.default_image);
+    if(greeter.state.list_image.default_image)
+        list_image = g_object_ref(greeter.state.list_image.default_image);
+    if(config.appearance.user_image.enabled || config.appearance.list_image.enabled)
+    {
+        update_user_image_identity(info, image_file);
+        load_user_images(user_name, image_file, greeter.state.user_image.size, greeter.state.list_image.size,
+                         &user_image, &list_image);
+    }
+
+    gtk_list_store_append(greeter.ui.users_model, &info->iter);
+    gtk_list_store_set(greeter.ui.users_model, &info->iter,
                        USER_COLUMN_NAME, user_name,
                        USER_COLUMN_TYPE, USER_TYPE_REGULAR,
                        USER_COLUMN_DISPLAY_NAME, display_name,
@@ -612,6 +965,10 @@ static void append_user(LightDMUser* user,
                        USER_COLUMN_LOGGED_IN, lightdm_user_get_logged_in(user),
                        -1);
     g_free(display_name);
+    g_clear_object(&user_image);
+    g_clear_object(&list_image);
+
+    g_hash_table_insert(greeter.state.users_rows, info->name, info);
 }
 
 static void append_custom_user(gint type,
@@ -633,28 +990,80 @@ static void append_custom_user(gint type,
                        -1);
 }
 
+/* Returns list of users to show in recent-users mode, NULL if mode is disabled or history is empty.
+   Lookup reads whole LightDM users list: it is needed anyway by start_authentication() for selected user */
+static GList* get_recent_users(void)
+{
+    if(config.greeter.recent_users_limit <= 0)
+        return NULL;
+
+    gchar** names = get_state_value_str_list("greeter", "recent-users");
+    if(!names)
+        return NULL;
+
+    GList* users = NULL;
+    gint count = 0;
+    for(gchar** name = names; *name && count < config.greeter.recent_users_limit; ++name)
+    {
+        LightDMUser* user = lightdm_user_list_get_user_by_name(lightdm_user_list_get_instance(), *name);
+        if(user)
+        {
+            users = g_list_prepend(users, user);
+            count++;
+        }
+    }
+    g_strfreev(names);
+    return g_list_reverse(users);
+}
+
+static void update_recent_users(const gchar* user_name)
+{
+    if(!user_name || g_strcmp0(user_name, USER_OTHER) == 0 || g_strcmp0(user_name, USER_GUEST) == 0)
+        return;
+
+    gchar** names = get_state_value_str_list("greeter", "recent-users");
+    const gint max_count = MAX(config.greeter.recent_users_limit, RECENT_USERS_MIN_HISTORY);
+    GPtrArray* recent = g_ptr_array_new();
+
+    g_ptr_array_add(recent, (gpointer)user_name);
+    for(gchar** name = names; name && *name && recent->len < (guint)max_count; ++name)
+        if(g_strcmp0(*name, user_name) != 0)
+            g_ptr_array_add(recent, *name);
+    g_ptr_array_add(recent, NULL);
+
+    set_state_value_str_list("greeter", "recent-users", (const gchar* const*)recent->pdata);
+    g_ptr_array_free(recent, TRUE);
+    g_strfreev(names);
+}
+
 static gboolean load_users_list(void)
 {
     g_message("Reading users list");
 
-    greeter.state.users_display_names = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+    greeter.state.users_display_names = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
+    greeter.state.users_rows = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)free_user_row_info);
 
-    const GList* items = lightdm_user_list_get_users(lightdm_user_list_get_instance());
+    GList* recent_users = get_recent_users();
+    const GList* items = recent_users ? recent_users : lightdm_user_list_get_users(lightdm_user_list_get_instance());
     const GList* item;
     GtkTreeIter iter;
 
+    greeter.state.recent_users_only = recent_users != NULL;
+    if(greeter.state.recent_users_only)
+        g_message("Showing %d recently logged in users", g_list_length(recent_users));
+
     g_return_val_if_fail(items != NULL, FALSE);
 
     for(item = items; item != NULL; item = item->next)
-        update_users_names_table(lightdm_user_get_display_name(item->data));
+        append_user(item->data);
 
-    for(item = items; item != NULL; item = item->next)
-        append_user(item->data, FALSE);
+    g_list_free(recent_users);
 
     if(lightdm_greeter_get_has_guest_account_hint(greeter.greeter))
         append_custom_user(USER_TYPE_GUEST, USER_GUEST, _("Guest Account"));
 
-    if(config.greeter.allow_other_users || greeter.state.no_users_list)
+    /* Other users are reachable only by typing login name */
+    if(config.greeter.allow_other_users || greeter.state.no_users_list || greeter.state.recent_users_only)
         append_custom_user(USER_TYPE_OTHER, USER_OTHER, _("Other..."));
 
     if(!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(greeter.ui.users_model), &iter))
@@ -666,97 +1075,112 @@ static gboolean load_users_list(void)
     return TRUE;
 }
 
-static GdkPixbuf* get_session_image(const gchar* session,
-                                    gboolean check_alter_names)
+static void set_session_row(GtkTreeIter* iter,
+                            const gchar* key,
+                            const gchar* name,
+                            const gchar* comment)
 {
-    static GHashTable* images_cache = NULL;
-    if(!config.greeter.show_session_icon)
-        return NULL;
-    if(!images_cache)
-        images_cache = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
-
-    GdkPixbuf* pixbuf = g_hash_table_lookup(images_cache, session);
-    if(pixbuf)
-        return pixbuf;
-
-    gchar* image_name = g_strdup_printf("%s.png", session);
-    gchar* image_path = g_build_filename(GREETER_DATA_DIR, image_name, NULL);
-    pixbuf = gdk_pixbuf_new_from_file(image_path, NULL);
-    g_free(image_path);
-    g_free(image_name);
+    gtk_list_store_set(greeter.ui.sessions_model, iter,
+                       SESSION_COLUMN_NAME, key,
+                       SESSION_COLUMN_DISPLAY_NAME, name,
+                       SESSION_COLUMN_IMAGE, config.greeter.show_session_icon ? get_session_image(key) : NULL,
+                       SESSION_COLUMN_COMMENT, *comment ? comment : NULL,
+                       -1);
+}
 
-    if(pixbuf)
-        g_hash_table_insert(images_cache, g_strdup(session), pixbuf);
-    else if(check_alter_names)
+/* Session images atlas was rebuilt in background: rows added before have no images */
+static void on_session_images_ready(void)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(greeter.ui.sessions_model);
+    GtkTreeIter iter;
+    for(gboolean valid = gtk_tree_model_get_iter_first(model, &iter); valid; valid = gtk_tree_model_iter_next(model, &iter))
     {
-        if(g_strcmp0(session, "ubuntu-2d") == 0)
-            pixbuf = get_session_image("ubuntu", FALSE);
-        else if(g_strcmp0(session, "gnome-classic") == 0 ||
-                g_strcmp0(session, "gnome-fallback") == 0 ||
-                g_strcmp0(session, "gnome-shell") == 0)
-            pixbuf = get_session_image("gnome", FALSE);
-        else if(g_strcmp0(session, "kde-plasma") == 0)
-            pixbuf = get_session_image("kde", FALSE);
+        gchar* key = NULL;
+        gtk_tree_model_get(model, &iter, SESSION_COLUMN_NAME, &key, -1);
+        gtk_list_store_set(greeter.ui.sessions_model, &iter, SESSION_COLUMN_IMAGE, key ? get_session_image(key) : NULL, -1);
+        g_free(key);
     }
-    return pixbuf;
 }
 
+/* Fills model with all sessions, placeholder row added by set_session() is reused */
 static void load_sessions_list(void)
 {
+    if(greeter.state.sessions.loaded)
+        return;
+    greeter.state.sessions.loaded = TRUE;
+
     g_message("Reading sessions list");
+    const SessionsCatalog* catalog = get_sessions_catalog();
     GtkTreeIter iter;
-    for(const GList* item = lightdm_get_sessions(); item != NULL; item = item->next)
+    gboolean reuse_row = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(greeter.ui.sessions_model), &iter);
+    for(gint i = 0; catalog->keys[i]; ++i)
     {
-        LightDMSession* session = item->data;
-        const gchar* name = lightdm_session_get_key(session);
-        gtk_list_store_append(greeter.ui.sessions_model, &iter);
-        gtk_list_store_set(greeter.ui.sessions_model, &iter,
-                           SESSION_COLUMN_NAME, name,
-                           SESSION_COLUMN_DISPLAY_NAME, lightdm_session_get_name(session),
-                           SESSION_COLUMN_IMAGE, get_session_image(name, TRUE),
-                           SESSION_COLUMN_COMMENT, lightdm_session_get_comment(session),
-                           -1);
+        if(!reuse_row)
+            gtk_list_store_append(greeter.ui.sessions_model, &iter);
+        reuse_row = FALSE;
+        set_session_row(&iter, catalog->keys[i], catalog->names[i], catalog->comments[i]);
+    }
+
+    if(greeter.state.sessions.pending)
+    {
+        greeter.state.sessions.pending = FALSE;
+        set_session(greeter.state.sessions.requested);
+        g_clear_pointer(&greeter.state.sessions.requested, g_free);
     }
 }
 
+/* Fills model with all languages, placeholder row added by set_language() is reused */
 static gboolean load_languages_list(void)
 {
+    if(greeter.state.languages.loaded)
+        return TRUE;
+    greeter.state.languages.loaded = TRUE;
+
     g_message("Reading languages list");
 
-    const GList* items = lightdm_get_languages();
-    if(!items)
+    const LanguagesCatalog* catalog = get_languages_catalog();
+    if(!catalog->codes)
     {
-        g_warning("lightdm_get_languages() return NULL");
+        gtk_list_store_clear(greeter.ui.languages_model);
+        gtk_widget_hide(greeter.ui.languages_box);
+        greeter.state.languages.pending = FALSE;
+        g_clear_pointer(&greeter.state.languages.requested, g_free);
         return FALSE;
     }
     GtkTreeIter iter;
-    for(const GList* item = items; item != NULL; item = item->next)
+    gboolean reuse_row = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(greeter.ui.languages_model), &iter);
+    for(gint i = 0; catalog->codes[i]; ++i)
     {
-        LightDMLanguage* language = item->data;
-
-        const gchar* code = lightdm_language_get_code(language);
-        const gchar* country = lightdm_language_get_territory(language);
-        gchar* label = country ? g_strdup_printf("%s - %s", lightdm_language_get_name(language), country)
-                               : g_strdup(lightdm_language_get_name(language));
-
-        const gchar* modifier = strchr(code, '@');
-        if(modifier != NULL)
-        {
-            gchar* label_new = g_strdup_printf("%s [%s]", label, modifier + 1);
-            g_free(label);
-            label = label_new;
-        }
-
-        gtk_list_store_append(greeter.ui.languages_model, &iter);
+        if(!reuse_row)
+            gtk_list_store_append(greeter.ui.languages_model, &iter);
+        reuse_row = FALSE;
         gtk_list_store_set(greeter.ui.languages_model, &iter,
-                           LANGUAGE_COLUMN_CODE, code,
-                           LANGUAGE_COLUMN_DISPLAY_NAME, label,
+                           LANGUAGE_COLUMN_CODE, catalog->codes[i],
+                           LANGUAGE_COLUMN_DISPLAY_NAME, catalog->labels[i],
                            -1);
-        g_free(label);
+    }
+
+    if(greeter.state.languages.pending)
+    {
+        greeter.state.languages.pending = FALSE;
+        set_language(greeter.state.languages.requested);
+        g_clear_pointer(&greeter.state.languages.requested, g_free);
     }
     return TRUE;
 }
 
+/* Loads one list per call to let main loop process events between them */
+static gboolean load_lists_idle(gpointer dummy)
+{
+    if(!greeter.state.sessions.loaded)
+    {
+        load_sessions_list();
+        return G_SOURCE_CONTINUE;
+    }
+    load_languages_list();
+    return G_SOURCE_REMOVE;
+}
+
 static gboolean get_first_logged_user(GtkTreeIter* iter)
 {
     if(!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(greeter.ui.users_model), iter))
@@ -836,10 +1260,13 @@ static void set_screen_background(GdkScreen* screen,
     cairo_surface_t *surface;
     cairo_t *cairo;
 
+    /* Pixmap of previous call, kept by server after its connection was closed */
+    static Pixmap old_pixmap = None;
+
     if(set_props)
     {
-        prop_root = XInternAtom(GDK_SCREEN_XDISPLAY(screen), "_XROOTPMAP_ID", False);
-        prop_esetroot = XInternAtom(GDK_SCREEN_XDISPLAY(screen), "ESETROOT_PMAP_ID", False);
+        prop_root = x11_get_atom(X11_ATOM_XROOTPMAP_ID);
+        prop_esetroot = x11_get_atom(X11_ATOM_ESETROOT_PMAP_ID);
         if(!prop_root && !prop_esetroot)
             set_props = FALSE;
     }
@@ -851,6 +1278,8 @@ static void set_screen_background(GdkScreen* screen,
                            DisplayHeight(GDK_SCREEN_XDISPLAY(screen), GDK_SCREEN_XNUMBER(screen)),
                            DefaultDepth(GDK_SCREEN_XDISPLAY(screen), GDK_SCREEN_XNUMBER(screen)));
     XCloseDisplay(pixmap_display);
+    /* Connection setup and closing */
+    x11_count_round_trip(2);
 
     surface = cairo_xlib_surface_create(GDK_SCREEN_XDISPLAY(screen), pixmap,
                                         DefaultVisual(GDK_SCREEN_XDISPLAY(screen), 0),
@@ -895,15 +1324,22 @@ static void set_screen_background(GdkScreen* screen,
         XChangeProperty(GDK_SCREEN_XDISPLAY(screen), root_window, prop_esetroot, XA_PIXMAP,
                         32, PropModeReplace, (guchar*)&pixmap_as_long, 1);
     }
-    gdk_flush();
+    /* Requests of one connection are processed in order, no need to wait for drawing here */
     XClearWindow(GDK_SCREEN_XDISPLAY(screen), root_window);
+    if(old_pixmap != None)
+        XKillClient(GDK_SCREEN_XDISPLAY(screen), old_pixmap);
+    old_pixmap = pixmap;
+    XFlush(GDK_SCREEN_XDISPLAY(screen));
 }
 
 static gboolean on_draw_screen_background(GtkWidget* widget,
                                          cairo_t* cr,
                                          gpointer data)
 {
-    gdk_cairo_set_source_pixbuf(cr, greeter.state.window_background, 0, 0);
+    if(greeter.state.window_background_surface)
+        cairo_set_source_surface(cr, greeter.state.window_background_surface, 0, 0);
+    else
+        gdk_cairo_set_source_pixbuf(cr, greeter.state.window_background, 0, 0);
     cairo_paint(cr);
     return FALSE;
 }
@@ -914,6 +1350,13 @@ static void set_window_background(GdkWindow* window,
                                   GdkRGBA* color)
 {
     static gulong draw_handler_id = 0;
+    g_clear_pointer(&greeter.state.window_background_surface, cairo_surface_destroy);
+    g_clear_object(&greeter.state.window_background);
+    if(draw_handler_id)
+    {
+        g_signal_handler_disconnect(greeter.ui.screen_window, draw_handler_id);
+        draw_handler_id = 0;
+    }
     if(image)
     {
         GdkPixbuf* pixbuf = gdk_pixbuf_scale_simple(image,
@@ -933,17 +1376,30 @@ static void set_window_background(GdkWindow* window,
     }
     else
     {
-        if(draw_handler_id)
-        {
-            gtk_widget_set_app_paintable(greeter.ui.screen_window, FALSE);
-            g_signal_handler_disconnect(greeter.ui.screen_window, draw_handler_id);
-        }
+        gtk_widget_set_app_paintable(greeter.ui.screen_window, FALSE);
         gtk_widget_override_background_color(greeter.ui.screen_window, GTK_STATE_FLAG_NORMAL, color);
     }
 }
 
+void release_window_background(void)
+{
+    if(!greeter.state.window_background)
+        return;
+    GdkWindow* window = gtk_widget_get_window(greeter.ui.screen_window);
+    cairo_surface_t* surface = gdk_window_create_similar_surface(window, CAIRO_CONTENT_COLOR,
+                                                                 gdk_pixbuf_get_width(greeter.state.window_background),
+                                                                 gdk_pixbuf_get_height(greeter.state.window_background));
+    cairo_t* cr = cairo_create(surface);
+    gdk_cairo_set_source_pixbuf(cr, greeter.state.window_background, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    greeter.state.window_background_surface = surface;
+    g_clear_object(&greeter.state.window_background);
+}
+
 static void set_background(const gchar* value)
 {
+    WATCHDOG_OPERATION("set_background");
     if(g_strcmp0(value, greeter.state.last_background) == 0)
         return;
 
@@ -959,7 +1415,7 @@ static void set_background(const gchar* value)
         g_debug("Loading background from file: %s", value);
 
         GError* error = NULL;
-        background_pixbuf = gdk_pixbuf_new_from_file(value, &error);
+        background_pixbuf = read_data_pixbuf(value, &error);
         if(error)
         {
             g_warning("Failed to load background: %s", error->message);
@@ -1022,7 +1478,7 @@ static void set_logo_image(void)
     {
         g_debug("Loading logo from file: %s", config.appearance.logo);
         GError* error = NULL;
-        GdkPixbuf* pixbuf = gdk_pixbuf_new_from_file(config.appearance.logo, &error);
+        GdkPixbuf* pixbuf = read_data_pixbuf(config.appearance.logo, &error);
         if(pixbuf)
             gtk_image_set_from_pixbuf(GTK_IMAGE(greeter.ui.logo_image_widget), pixbuf);
         else
@@ -1053,17 +1509,6 @@ static void set_prompt_text(const gchar* text)
     }
 }
 
-static gboolean update_date_label(gpointer dummy)
-{
-    GDateTime* datetime = g_date_time_new_now_local();
-    g_return_val_if_fail(datetime != NULL, FALSE);
-    gchar* str = g_date_time_format(datetime, config.appearance.date_format);
-    set_widget_text(greeter.ui.date_widget, str);
-    g_free(str);
-    g_date_time_unref(datetime);
-    return TRUE;
-}
-
 static void set_login_button_width(void)
 {
     if(greeter.ui.login_label || GTK_IS_BIN(greeter.ui.login_widget))
@@ -1079,8 +1524,72 @@ static void set_login_button_width(void)
     }
 }
 
+static void free_screenshot_data(ScreenshotData* data)
+{
+    cairo_surface_destroy(data->image);
+    g_free(data->file_path);
+    g_free(data);
+}
+
+static void save_screenshot_thread(GTask* task,
+                                   gpointer source_object,
+                                   ScreenshotData* data,
+                                   GCancellable* cancellable)
+{
+    GError* error = NULL;
+    GdkPixbuf* pixbuf = gdk_pixbuf_get_from_surface(data->image, 0, 0,
+                                                    cairo_image_surface_get_width(data->image),
+                                                    cairo_image_surface_get_height(data->image));
+    gboolean saved;
+    if(g_strcmp0(config.greeter.screenshot_format, "png") == 0)
+    {
+        gchar* compression = g_strdup_printf("%d", CLAMP(config.greeter.screenshot_compression, 0, 9));
+        saved = gdk_pixbuf_save(pixbuf, data->file_path, "png", &error, "compression", compression, NULL);
+        g_free(compression);
+    }
+    else
+        saved = gdk_pixbuf_save(pixbuf, data->file_path, config.greeter.screenshot_format, &error, NULL);
+    g_object_unref(pixbuf);
+    if(saved)
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
+}
+
+static gboolean on_screenshot_message_timeout(gpointer data)
+{
+    if(GTK_IS_LABEL(greeter.ui.message_widget) &&
+       g_strcmp0(gtk_label_get_text(GTK_LABEL(greeter.ui.message_widget)), data) == 0)
+        set_message_text(NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static void on_screenshot_saved(GObject* source_object,
+                                GAsyncResult* result,
+                                gpointer user_data)
+{
+    ScreenshotData* data = g_task_get_task_data(G_TASK(result));
+    GError* error = NULL;
+    if(!g_task_propagate_boolean(G_TASK(result), &error))
+    {
+        g_warning("Failed: %s", error->message);
+        show_message_dialog(GTK_MESSAGE_ERROR, _("Screenshot"),
+                            "%s", error->message);
+        g_clear_error(&error);
+        return;
+    }
+
+    g_message("Screenshot saved as \"%s\" (%.0f ms)", data->file_path,
+              (g_get_monotonic_time() - data->started)/1000.0);
+    gchar* text = g_strdup_printf(_("Screenshot saved as \"%s\""), data->file_path);
+    set_message_text(text);
+    g_timeout_add_seconds_full(G_PRIORITY_DEFAULT, SCREENSHOT_MESSAGE_TIMEOUT,
+                               on_screenshot_message_timeout, text, g_free);
+}
+
 static void take_screenshot(void)
 {
+    WATCHDOG_OPERATION("take_screenshot");
     g_debug("Taking screenshot");
     gchar* file_dir = g_build_filename(g_get_tmp_dir(), APP_NAME, NULL);
     if(g_mkdir_with_parents(file_dir, 02755) != 0)
@@ -1090,36 +1599,48 @@ static void take_screenshot(void)
         return;
     }
 
-    GdkWindow* root_window = gdk_get_default_root_window();
-    GdkPixbuf* screenshot = gdk_pixbuf_get_from_window(root_window, 0, 0,
-                                                       gdk_window_get_width(root_window),
-                                                       gdk_window_get_height(root_window));
+    ScreenshotData* data = g_malloc0(sizeof(ScreenshotData));
+    data->started = g_get_monotonic_time();
+
+    /* Cairo reads xlib surfaces through MIT-SHM if server supports it.
+       Converting to pixbuf is left for worker thread */
+    GdkScreen* screen = gdk_screen_get_default();
+    const gint width = gdk_screen_get_width(screen);
+    const gint height = gdk_screen_get_height(screen);
+    cairo_surface_t* root_surface = cairo_xlib_surface_create(GDK_SCREEN_XDISPLAY(screen),
+                                                              GDK_WINDOW_XID(gdk_screen_get_root_window(screen)),
+                                                              GDK_VISUAL_XVISUAL(gdk_screen_get_system_visual(screen)),
+                                                              width, height);
+    data->image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+    cairo_t* cr = cairo_create(data->image);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, root_surface, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_destroy(root_surface);
 
     GDateTime* datetime = g_date_time_new_now_local();
-
-    gchar* file_name = datetime ? g_date_time_format(datetime, "screenshot_%F_%T.png") : g_strdup("screenshot.png");
-    gchar* file_path = g_build_filename(file_dir, file_name, NULL);
-
-    GError* error = NULL;
-    gdk_pixbuf_save(screenshot, file_path, "png", &error, NULL);
-    if(error)
-    {
-        g_warning("Failed: %s", error->message);
-        show_message_dialog(GTK_MESSAGE_ERROR, _("Screenshot"),
-                            "%s", error->message);
-        g_clear_error(&error);
-    }
-    else
-        g_message("Screenshot saved as \"%s\"", file_path);
-    g_date_time_unref(datetime);
-    g_object_unref(screenshot);
-    g_free(file_path);
+    gchar* file_name_format = g_strdup_printf("screenshot_%%F_%%T.%s", config.greeter.screenshot_format);
+    gchar* file_name = datetime ? g_date_time_format(datetime, file_name_format)
+                                : g_strdup_printf("screenshot.%s", config.greeter.screenshot_format);
+    data->file_path = g_build_filename(file_dir, file_name, NULL);
+    g_debug("Screenshot captured (%.0f ms)", (g_get_monotonic_time() - data->started)/1000.0);
+
+    GTask* task = g_task_new(NULL, NULL, on_screenshot_saved, NULL);
+    g_task_set_task_data(task, data, (GDestroyNotify)free_screenshot_data);
+    g_task_run_in_thread(task, (GTaskThreadFunc)save_screenshot_thread);
+    g_object_unref(task);
+
+    if(datetime)
+        g_date_time_unref(datetime);
+    g_free(file_name_format);
     g_free(file_name);
     g_free(file_dir);
 }
 
 static void start_authentication(const gchar* user_name)
 {
+    WATCHDOG_OPERATION("start_authentication");
     g_message("Starting authentication for user \"%s\"", user_name);
 
     set_state_value_str("greeter", "last-user", user_name);
@@ -1168,8 +1689,12 @@ static void cancel_authentication(void)
 
 static void start_session(void)
 {
+    if(greeter.state.starting_session)
+        return;
     g_message("Starting session for authenticated user");
 
+    /* State file is written while LightDM starts session */
+    freeze_state();
     gchar* language = get_language();
     if(language)
     {
@@ -1180,6 +1705,8 @@ static void start_session(void)
     gchar* user_name = get_user_name();
     set_state_value_str("greeter", "last-user", user_name);
     g_free(user_name);
+    /* User is authenticated: recorded even if session fails to start, with one state file write */
+    update_recent_users(lightdm_greeter_get_authentication_user(greeter.greeter));
 
     gchar* session = get_session();
     if(!session)
@@ -1194,18 +1721,63 @@ static void start_session(void)
         else
             show_message_dialog(0, "", "No session selected and no default session");
     }
-    if(lightdm_greeter_start_session_sync(greeter.greeter, session, NULL))
+
+    set_session_starting(TRUE);
+    metrics_mark(METRIC_EVENT_SESSION_REQUESTED);
+    lightdm_greeter_start_session(greeter.greeter, session, NULL, on_session_started, NULL);
+    thaw_state();
+    g_free(session);
+}
+
+static void on_session_started(GObject* source_object,
+                               GAsyncResult* result,
+                               gpointer data)
+{
+    GError* error = NULL;
+    if(lightdm_greeter_start_session_finish(greeter.greeter, result, &error))
     {
-        gtk_widget_hide(greeter.ui.main_layout);
-        gtk_widget_hide(greeter.ui.panel_layout);
+        g_message("Session started");
+        metrics_mark(METRIC_EVENT_SESSION_STARTED);
+        /* Not closed when request is sent: keyboard is needed to authenticate again if session fails */
         a11y_close();
+        return;
     }
-    else
+
+    g_warning("Failed to start session: %s", error ? error->message : "unknown error");
+    g_clear_error(&error);
+    metrics_mark(METRIC_EVENT_SESSION_FAILED);
+    set_session_starting(FALSE);
+    set_message_text(_("Failed to start session"));
+    start_authentication(lightdm_greeter_get_authentication_user(greeter.greeter));
+}
+
+/* Hide greeter and show busy cursor until LightDM response, restore it if session failed */
+static void set_session_starting(gboolean starting)
+{
+    /* Panel and onboard can be hidden by configuration or user */
+    static gboolean panel_visible = FALSE;
+    static gboolean onboard_visible = FALSE;
+
+    greeter.state.starting_session = starting;
+    if(starting)
     {
-        set_message_text(_("Failed to start session"));
-        start_authentication(lightdm_greeter_get_authentication_user(greeter.greeter));
+        panel_visible = gtk_widget_get_visible(greeter.ui.panel_layout);
+        onboard_visible = greeter.ui.onboard_layout && gtk_widget_get_visible(greeter.ui.onboard_layout);
     }
-    g_free(session);
+    gtk_widget_set_visible(greeter.ui.main_layout, !starting);
+    gtk_widget_set_visible(greeter.ui.panel_layout, !starting && panel_visible);
+    if(greeter.ui.onboard_layout)
+        gtk_widget_set_visible(greeter.ui.onboard_layout, !starting && onboard_visible);
+
+    GdkWindow* window = gtk_widget_get_window(greeter.ui.screen_window);
+    if(starting)
+    {
+        GdkCursor* cursor = gdk_cursor_new_for_display(gdk_window_get_display(window), GDK_WATCH);
+        gdk_window_set_cursor(window, cursor);
+        g_object_unref(cursor);
+    }
+    else
+        gdk_window_set_cursor(window, NULL);
 }
 
 static gchar* get_user_name(void)
@@ -1224,13 +1796,49 @@ static UserType get_user_type(void)
 
 static gchar* get_session(void)
 {
+    load_sessions_list();
     return get_widget_selection_str(greeter.ui.sessions_widget,
                                     SESSION_COLUMN_NAME,
                                     lightdm_greeter_get_default_session_hint(greeter.greeter));
 }
 
+/* Replaces model content with single row: session or default session.
+   Sessions catalog is not read here, only <key>.desktop: full list is loaded later */
+static void set_session_placeholder(const gchar* session)
+{
+    g_free(greeter.state.sessions.requested);
+    greeter.state.sessions.requested = g_strdup(session);
+    greeter.state.sessions.pending = TRUE;
+
+    const gchar* default_session = lightdm_greeter_get_default_session_hint(greeter.greeter);
+    const gchar* key = session ? session : default_session;
+    gchar* name = NULL;
+    gchar* comment = NULL;
+    if(key && !get_session_info(key, &name, &comment) && default_session && g_strcmp0(key, default_session) != 0)
+    {
+        key = default_session;
+        get_session_info(key, &name, &comment);
+    }
+    if(!key)
+        return;
+
+    GtkTreeIter iter;
+    if(!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(greeter.ui.sessions_model), &iter))
+        gtk_list_store_append(greeter.ui.sessions_model, &iter);
+    set_session_row(&iter, key, name ? name : key, comment ? comment : "");
+    set_widget_active_iter(greeter.ui.sessions_widget, &iter);
+    g_free(name);
+    g_free(comment);
+}
+
 static void set_session(const gchar* session)
 {
+    if(!greeter.state.sessions.loaded)
+    {
+        set_session_placeholder(session);
+        return;
+    }
+
     GtkTreeIter iter;
     if(session && get_model_iter_str(greeter.ui.sessions_model, SESSION_COLUMN_NAME, session, &iter))
     {
@@ -1248,11 +1856,42 @@ static void set_session(const gchar* session)
 
 static gchar* get_language(void)
 {
+    load_languages_list();
     return get_widget_selection_str(greeter.ui.languages_widget, LANGUAGE_COLUMN_CODE, NULL);
 }
 
+/* Replaces model content with single row: language or language from environment.
+   Language is not checked for existence here (it requires full list), set_language() is called again after loading */
+static void set_language_placeholder(const gchar* language)
+{
+    g_free(greeter.state.languages.requested);
+    greeter.state.languages.requested = g_strdup(language);
+    greeter.state.languages.pending = TRUE;
+
+    const gchar* code = language && *language ? language : g_getenv("LANG");
+    if(!code || !*code)
+        return;
+
+    gchar* label = get_language_label(code);
+    GtkTreeIter iter;
+    if(!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(greeter.ui.languages_model), &iter))
+        gtk_list_store_append(greeter.ui.languages_model, &iter);
+    gtk_list_store_set(greeter.ui.languages_model, &iter,
+                       LANGUAGE_COLUMN_CODE, code,
+                       LANGUAGE_COLUMN_DISPLAY_NAME, label,
+                       -1);
+    set_widget_active_iter(greeter.ui.languages_widget, &iter);
+    g_free(label);
+}
+
 static void set_language(const gchar* language)
 {
+    if(!greeter.state.languages.loaded)
+    {
+        set_language_placeholder(language);
+        return;
+    }
+
     GtkTreeIter iter;
     if(language && get_model_iter_str(greeter.ui.languages_model, LANGUAGE_COLUMN_CODE, language, &iter))
     {
@@ -1289,7 +1928,7 @@ void update_default_user_image(void)
     }
     else
     {
-        GdkPixbuf* image = gdk_pixbuf_new_from_file(config.appearance.default_user_image, NULL);
+        GdkPixbuf* image = read_data_pixbuf(config.appearance.default_user_image, NULL);
         if(image)
         {
             if(config.appearance.user_image.enabled)
@@ -1377,6 +2016,7 @@ static void on_show_prompt(LightDMGreeter* greeter_ptr,
                            LightDMPromptType type)
 {
     g_debug("LightDM signal: show-prompt (%s)", text);
+    metrics_mark(METRIC_EVENT_PROMPTED);
 
     greeter.state.password_required = (type == LIGHTDM_PROMPT_TYPE_SECRET);
     greeter.state.prompted = TRUE;
@@ -1399,12 +2039,14 @@ static void on_show_message(LightDMGreeter* greeter_ptr,
                             LightDMMessageType type)
 {
     g_debug("LightDM signal: show-message(%d: %s)", type, text);
+    metrics_mark(METRIC_EVENT_PROMPTED);
     set_message_text(text);
 }
 
 static void on_authentication_complete(LightDMGreeter* greeter_ptr)
 {
     g_debug("LightDM signal: authentication-complete");
+    metrics_mark(METRIC_EVENT_AUTHENTICATED);
     gtk_entry_set_text(GTK_ENTRY(greeter.ui.prompt_entry), "");
 
     if(greeter.state.cancelling)
@@ -1453,34 +2095,52 @@ static void on_user_added(LightDMUserList* user_list,
                           LightDMUser* user)
 {
     g_debug("LightDM signal: user-added");
-    append_user(user, TRUE);
+    if(!greeter.state.users_rows || greeter.state.recent_users_only)
+        return;
+    append_user(user);
 }
 
 static void on_user_changed(LightDMUserList* user_list,
                             LightDMUser* user)
 {
     g_debug("LightDM signal: user-changed");
-    GtkTreeIter iter;
-    const gchar* name = lightdm_user_get_name(user);
-    if(!get_model_iter_str(greeter.ui.users_model, USER_COLUMN_NAME, name, &iter))
+    UserRowInfo* info = greeter.state.users_rows ? g_hash_table_lookup(greeter.state.users_rows, lightdm_user_get_name(user)) : NULL;
+    if(!info)
         return;
 
-    gtk_list_store_set(greeter.ui.users_model, &iter,
-                       USER_COLUMN_NAME, name,
-                       USER_COLUMN_DISPLAY_NAME, lightdm_user_get_display_name(user),
+    if(g_strcmp0(info->display_name, lightdm_user_get_display_name(user)) != 0)
+    {
+        unregister_user_display_name(info);
+        g_free(info->display_name);
+        info->display_name = g_strdup(lightdm_user_get_display_name(user));
+        register_user_display_name(info);
+    }
+
+    gchar* display_name = get_user_display_name(info);
+    gtk_list_store_set(greeter.ui.users_model, &info->iter,
+                       USER_COLUMN_DISPLAY_NAME, display_name,
                        USER_COLUMN_WEIGHT, lightdm_user_get_logged_in(user) ? PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL,
+                       USER_COLUMN_LOGGED_IN, lightdm_user_get_logged_in(user),
                        -1);
+    g_free(display_name);
+
+    if((config.appearance.user_image.enabled || config.appearance.list_image.enabled) &&
+       update_user_image_identity(info, lightdm_user_get_image(user)))
+        reload_user_images_async(info);
 }
 
 void on_user_removed(LightDMUserList* user_list,
                      LightDMUser* user)
 {
     g_debug("LightDM signal: user-removed");
-    GtkTreeIter iter;
     const gchar* name = lightdm_user_get_name(user);
-    if(!get_model_iter_str(greeter.ui.users_model, USER_COLUMN_NAME, name, &iter))
+    UserRowInfo* info = greeter.state.users_rows ? g_hash_table_lookup(greeter.state.users_rows, name) : NULL;
+    if(!info)
         return;
-    gtk_list_store_remove(greeter.ui.users_model, &iter);
+
+    unregister_user_display_name(info);
+    gtk_list_store_remove(greeter.ui.users_model, &info->iter);
+    g_hash_table_remove(greeter.state.users_rows, name);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -1490,11 +2150,13 @@ void on_user_removed(LightDMUserList* user_list,
 void on_login_clicked(GtkWidget* widget,
                       gpointer data)
 {
+    metrics_mark(METRIC_EVENT_LOGIN_CLICKED);
     if(lightdm_greeter_get_is_authenticated(greeter.greeter))
         start_session();
     else if(lightdm_greeter_get_in_authentication(greeter.greeter))
     {
         const gchar* text = gtk_entry_get_text(GTK_ENTRY(greeter.ui.prompt_entry));
+        metrics_mark(METRIC_EVENT_RESPONDED);
         lightdm_greeter_respond(greeter.greeter, text);
         gtk_widget_show(greeter.ui.cancel_box);
         if(get_user_type() == USER_TYPE_OTHER  && gtk_entry_get_visibility(GTK_ENTRY(greeter.ui.prompt_entry)))
@@ -1535,6 +2197,7 @@ void on_user_selection_changed(GtkWidget* widget,
 {
     gchar* user_name = get_user_name();
     g_debug("User selection changed: %s", user_name);
+    x11_phase_begin("User switch");
 
     update_user_image();
     set_message_text(NULL);
@@ -1553,6 +2216,7 @@ void on_user_selection_changed(GtkWidget* widget,
     else
         on_authentication_complete(greeter.greeter);
     #endif
+    x11_phase_end();
     g_free(user_name);
 }
 
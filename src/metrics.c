@@ -0,0 +1,241 @@
+/* metrics.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "shares.h"
+#include "metrics.h"
+
+/* Types */
+
+typedef enum
+{
+    /* Response to prompt -> next prompt or message */
+    METRIC_STAGE_PROMPT_RESPONSE,
+    /* Last response -> authentication-complete */
+    METRIC_STAGE_AUTHENTICATION,
+    /* Session request -> result */
+    METRIC_STAGE_SESSION_START,
+    /* Last click on login button -> session started */
+    METRIC_STAGE_LOGIN,
+    METRIC_STAGES_COUNT
+} MetricStage;
+
+/* Static constants */
+
+static const gchar* const METRICS_FILE = "auth-metrics";
+/* Bucket N holds durations of [2^(N-1), 2^N) ms, bucket 0 - less than 1 ms */
+#define METRICS_BUCKETS 24
+static const gchar* const STAGE_NAMES[METRIC_STAGES_COUNT] =
+{
+    [METRIC_STAGE_PROMPT_RESPONSE] = "prompt-response",
+    [METRIC_STAGE_AUTHENTICATION]  = "authentication",
+    [METRIC_STAGE_SESSION_START]   = "session-start",
+    [METRIC_STAGE_LOGIN]           = "login"
+};
+static const gdouble PERCENTILES[] = {0.5, 0.9, 0.99};
+
+/* Static variables */
+
+static struct
+{
+    gint64   login_time;
+    gint64   respond_time;
+    gboolean response_pending;
+    gint64   session_time;
+    /* Samples of current run, added to stored histograms by metrics_save() */
+    guint64  samples[METRIC_STAGES_COUNT][METRICS_BUCKETS];
+    gboolean changed;
+} metrics;
+
+/* Static functions */
+
+static void add_sample                  (MetricStage stage,
+                                         gint64 start_time);
+static gchar* get_metrics_path          (void);
+static void read_histograms             (GKeyFile* key_file,
+                                         guint64 histograms[METRIC_STAGES_COUNT][METRICS_BUCKETS]);
+static guint64 get_percentile_bound     (const guint64* buckets,
+                                         guint64 count,
+                                         gdouble percentile);
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void metrics_mark(MetricEvent event)
+{
+    const gint64 now = g_get_monotonic_time();
+    switch(event)
+    {
+        case METRIC_EVENT_LOGIN_CLICKED:
+            metrics.login_time = now;
+            break;
+        case METRIC_EVENT_RESPONDED:
+            metrics.respond_time = now;
+            metrics.response_pending = TRUE;
+            break;
+        case METRIC_EVENT_PROMPTED:
+            if(metrics.response_pending)
+                add_sample(METRIC_STAGE_PROMPT_RESPONSE, metrics.respond_time);
+            metrics.response_pending = FALSE;
+            break;
+        case METRIC_EVENT_AUTHENTICATED:
+            if(metrics.respond_time)
+                add_sample(METRIC_STAGE_AUTHENTICATION, metrics.respond_time);
+            metrics.respond_time = 0;
+            metrics.response_pending = FALSE;
+            break;
+        case METRIC_EVENT_SESSION_REQUESTED:
+            metrics.session_time = now;
+            break;
+        case METRIC_EVENT_SESSION_STARTED:
+            if(metrics.session_time)
+                add_sample(METRIC_STAGE_SESSION_START, metrics.session_time);
+            if(metrics.login_time)
+                add_sample(METRIC_STAGE_LOGIN, metrics.login_time);
+            metrics.session_time = metrics.login_time = 0;
+            /* Greeter is going to be stopped */
+            metrics_save();
+            break;
+        case METRIC_EVENT_SESSION_FAILED:
+            metrics.session_time = metrics.login_time = 0;
+            break;
+    }
+}
+
+void metrics_save(void)
+{
+    if(!metrics.changed)
+        return;
+
+    gchar* path = get_metrics_path();
+    GKeyFile* key_file = g_key_file_new();
+    g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL);
+
+    guint64 histograms[METRIC_STAGES_COUNT][METRICS_BUCKETS];
+    read_histograms(key_file, histograms);
+    for(MetricStage stage = 0; stage < METRIC_STAGES_COUNT; ++stage)
+    {
+        gint values[METRICS_BUCKETS];
+        for(gint i = 0; i < METRICS_BUCKETS; ++i)
+            values[i] = (gint)MIN(histograms[stage][i] + metrics.samples[stage][i], G_MAXINT);
+        g_key_file_set_integer_list(key_file, STAGE_NAMES[stage], "buckets", values, METRICS_BUCKETS);
+    }
+
+    GError* error = NULL;
+    gchar* dir = g_path_get_dirname(path);
+    if(g_mkdir_with_parents(dir, 0755) != 0 || !g_key_file_save_to_file(key_file, path, &error))
+        g_warning("Failed to save metrics file: %s", error ? error->message : path);
+    else
+    {
+        memset(metrics.samples, 0, sizeof(metrics.samples));
+        metrics.changed = FALSE;
+    }
+    g_clear_error(&error);
+    g_free(dir);
+    g_key_file_free(key_file);
+    g_free(path);
+}
+
+void metrics_dump(void)
+{
+    gchar* path = get_metrics_path();
+    GKeyFile* key_file = g_key_file_new();
+    if(!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL))
+    {
+        g_print("No authentication metrics (%s)\n", path);
+        g_key_file_free(key_file);
+        g_free(path);
+        return;
+    }
+
+    guint64 histograms[METRIC_STAGES_COUNT][METRICS_BUCKETS];
+    read_histograms(key_file, histograms);
+    g_print("%-16s %8s %10s %10s %10s %10s\n", "stage", "count", "p50, ms", "p90, ms", "p99, ms", "max, ms");
+    for(MetricStage stage = 0; stage < METRIC_STAGES_COUNT; ++stage)
+    {
+        guint64 count = 0;
+        for(gint i = 0; i < METRICS_BUCKETS; ++i)
+            count += histograms[stage][i];
+        g_print("%-16s %8" G_GUINT64_FORMAT, STAGE_NAMES[stage], count);
+        for(guint i = 0; i < G_N_ELEMENTS(PERCENTILES); ++i)
+            g_print(" %10" G_GUINT64_FORMAT, get_percentile_bound(histograms[stage], count, PERCENTILES[i]));
+        g_print(" %10" G_GUINT64_FORMAT "\n", get_percentile_bound(histograms[stage], count, 1.0));
+    }
+    g_print("Values are upper bounds of power of two buckets\n");
+    g_key_file_free(key_file);
+    g_free(path);
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static void add_sample(MetricStage stage,
+                       gint64 start_time)
+{
+    const guint64 duration = (g_get_monotonic_time() - start_time)/1000;
+    g_debug("Metrics: %s: %" G_GUINT64_FORMAT " ms", STAGE_NAMES[stage], duration);
+    /* g_bit_storage(0) is 1 */
+    metrics.samples[stage][MIN(duration ? g_bit_storage(duration) : 0, METRICS_BUCKETS - 1)]++;
+    metrics.changed = TRUE;
+}
+
+static gchar* get_metrics_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), APP_NAME, METRICS_FILE, NULL);
+}
+
+static void read_histograms(GKeyFile* key_file,
+                            guint64 histograms[METRIC_STAGES_COUNT][METRICS_BUCKETS])
+{
+    memset(histograms, 0, sizeof(guint64)*METRIC_STAGES_COUNT*METRICS_BUCKETS);
+    for(MetricStage stage = 0; stage < METRIC_STAGES_COUNT; ++stage)
+    {
+        gsize length = 0;
+        gint* values = g_key_file_get_integer_list(key_file, STAGE_NAMES[stage], "buckets", &length, NULL);
+        for(gsize i = 0; i < MIN(length, METRICS_BUCKETS); ++i)
+            histograms[stage][i] = MAX(values[i], 0);
+        g_free(values);
+    }
+}
+
+/* Upper bound of bucket containing given percentile, ms */
+static guint64 get_percentile_bound(const guint64* buckets,
+                                    guint64 count,
+                                    gdouble percentile)
+{
+    if(count == 0)
+        return 0;
+    const guint64 rank = MAX((guint64)(percentile*count + 0.5), 1);
+    guint64 accumulated = 0;
+    for(gint i = 0; i < METRICS_BUCKETS; ++i)
+    {
+        accumulated += buckets[i];
+        if(accumulated >= rank)
+            return i == 0 ? 1 : (guint64)1 << i;
+    }
+    return (guint64)1 << (METRICS_BUCKETS - 1);
+}
@@ -0,0 +1,50 @@
+/* metrics.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _METRICS_H_INCLUDED_
+#define _METRICS_H_INCLUDED_
+
+#include <glib.h>
+
+/* Types */
+
+/* Points of authentication flow */
+typedef enum
+{
+    METRIC_EVENT_LOGIN_CLICKED,
+    METRIC_EVENT_RESPONDED,
+    /* show-prompt or show-message */
+    METRIC_EVENT_PROMPTED,
+    METRIC_EVENT_AUTHENTICATED,
+    METRIC_EVENT_SESSION_REQUESTED,
+    METRIC_EVENT_SESSION_STARTED,
+    METRIC_EVENT_SESSION_FAILED
+} MetricEvent;
+
+/* Functions */
+
+/* Add latencies of finished stages to histograms */
+void metrics_mark                      (MetricEvent event);
+/* Write histograms to cache directory if they were changed */
+void metrics_save                      (void);
+/* Print percentiles of stored histograms to stdout */
+void metrics_dump                      (void);
+
+#endif // _METRICS_H_INCLUDED_
@@ -0,0 +1,278 @@
+/* probes.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <X11/XKBlib.h>
+#include <lightdm.h>
+
+#include "shares.h"
+#include "probes.h"
+#include "readahead.h"
+
+/* Types */
+
+typedef enum
+{
+    PROBE_PROGRAM,
+    PROBE_POWER_ACTIONS
+} ProbeType;
+
+typedef struct
+{
+    ProbeType   type;
+    GCallback   callback;
+    gpointer    data;
+
+    /* PROBE_PROGRAM */
+    gchar*      name;
+    gchar*      path;
+    /* PROBE_POWER_ACTIONS */
+    gboolean    allowed[POWER_ACTIONS_COUNT];
+} ProbeData;
+
+typedef struct
+{
+    XkbProbeCallback callback;
+    gpointer         data;
+} XkbProbeData;
+
+/* Static constants */
+
+static const gchar* const PROBES_CACHE_FILE = "probes";
+static const gchar* const PROGRAMS_GROUP    = "programs";
+static const gchar* const STAMPS_GROUP      = "stamps";
+
+/* Order of PowerAction */
+static gboolean (* const POWER_ACTION_PROBES[POWER_ACTIONS_COUNT])(void) =
+{
+    lightdm_get_can_suspend,
+    lightdm_get_can_hibernate,
+    lightdm_get_can_restart,
+    lightdm_get_can_shutdown
+};
+
+/* Static variables */
+
+static struct
+{
+    GMutex      lock;
+    GKeyFile*   cache;
+    gchar*      path;
+} probes_data;
+
+/* Static functions */
+
+static void run_probe                           (ProbeData* probe);
+static void probe_thread                        (GTask* task,
+                                                 gpointer source_object,
+                                                 ProbeData* probe,
+                                                 GCancellable* cancellable);
+static void on_probe_finished                   (GObject* source_object,
+                                                 GAsyncResult* result,
+                                                 ProbeData* probe);
+static gboolean probe_xkb_display_idle          (XkbProbeData* probe);
+static GKeyFile* get_cache_file                 (void);
+static gchar* get_path_stamp                    (void);
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void probe_program(const gchar* name,
+                   ProgramProbeCallback callback,
+                   gpointer data)
+{
+    ProbeData* probe = g_malloc0(sizeof(ProbeData));
+    probe->type = PROBE_PROGRAM;
+    probe->callback = G_CALLBACK(callback);
+    probe->data = data;
+    probe->name = g_strdup(name);
+    run_probe(probe);
+}
+
+void probe_power_actions(PowerProbeCallback callback,
+                         gpointer data)
+{
+    ProbeData* probe = g_malloc0(sizeof(ProbeData));
+    probe->type = PROBE_POWER_ACTIONS;
+    probe->callback = G_CALLBACK(callback);
+    probe->data = data;
+    run_probe(probe);
+}
+
+void probe_xkb_display(XkbProbeCallback callback,
+                       gpointer data)
+{
+    /* Xlib is not initialized for threads, so display is opened in main thread after first frame */
+    XkbProbeData* probe = g_malloc0(sizeof(XkbProbeData));
+    probe->callback = callback;
+    probe->data = data;
+    g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)probe_xkb_display_idle, probe, g_free);
+}
+
+gchar* find_program(const gchar* name)
+{
+    /* Absolute paths are checked directly, names with reserved characters can not be keys */
+    if(g_path_is_absolute(name) || strpbrk(name, "=[]\n") || !name[0])
+        return g_find_program_in_path(name);
+
+    g_mutex_lock(&probes_data.lock);
+
+    GKeyFile* cache = get_cache_file();
+    GError* error = NULL;
+    gchar* path = g_key_file_get_string(cache, PROGRAMS_GROUP, name, &error);
+    if(error)
+    {
+        g_clear_error(&error);
+        path = g_find_program_in_path(name);
+        g_key_file_set_string(cache, PROGRAMS_GROUP, name, path ? path : "");
+
+        gsize data_length = 0;
+        gchar* data = g_key_file_to_data(cache, &data_length, NULL);
+        if(!g_file_set_contents(probes_data.path, data, data_length, &error))
+        {
+            g_warning("Failed to save probes cache: %s", error->message);
+            g_clear_error(&error);
+        }
+        g_free(data);
+    }
+    else if(!path[0])
+    {
+        g_free(path);
+        path = NULL;
+    }
+
+    g_mutex_unlock(&probes_data.lock);
+    return path;
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static void run_probe(ProbeData* probe)
+{
+    GTask* task = g_task_new(NULL, NULL, (GAsyncReadyCallback)on_probe_finished, probe);
+    g_task_set_task_data(task, probe, NULL);
+    g_task_run_in_thread(task, (GTaskThreadFunc)probe_thread);
+    g_object_unref(task);
+}
+
+static void probe_thread(GTask* task,
+                         gpointer source_object,
+                         ProbeData* probe,
+                         GCancellable* cancellable)
+{
+    gint64 start_time = g_get_monotonic_time();
+
+    switch(probe->type)
+    {
+        case PROBE_PROGRAM:
+            probe->path = find_program(probe->name);
+            g_debug("Probe: program \"%s\": %s", probe->name, probe->path ? probe->path : "not found");
+            break;
+        case PROBE_POWER_ACTIONS:
+            for(gint i = 0; i < POWER_ACTIONS_COUNT; ++i)
+                probe->allowed[i] = POWER_ACTION_PROBES[i]();
+            g_debug("Probe: power actions");
+            break;
+    }
+
+    g_debug("Probe finished in %" G_GINT64_FORMAT " ms", (g_get_monotonic_time() - start_time)/1000);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_probe_finished(GObject* source_object,
+                              GAsyncResult* result,
+                              ProbeData* probe)
+{
+    switch(probe->type)
+    {
+        case PROBE_PROGRAM:
+            ((ProgramProbeCallback)probe->callback)(probe->name, probe->path, probe->data);
+            break;
+        case PROBE_POWER_ACTIONS:
+            ((PowerProbeCallback)probe->callback)(probe->allowed, probe->data);
+            break;
+    }
+    g_free(probe->name);
+    g_free(probe->path);
+    g_free(probe);
+}
+
+static gboolean probe_xkb_display_idle(XkbProbeData* probe)
+{
+    Display* display = XkbOpenDisplay(NULL, NULL, NULL, NULL, NULL, NULL);
+    g_debug("Probe: XKB display: %s", display ? "opened" : "not available");
+    probe->callback(display, probe->data);
+    return G_SOURCE_REMOVE;
+}
+
+/* Must be called with probes_data.lock held */
+static GKeyFile* get_cache_file(void)
+{
+    if(probes_data.cache)
+        return probes_data.cache;
+
+    gchar* cache_dir = g_build_filename(g_get_user_cache_dir(), APP_NAME, NULL);
+    g_mkdir_with_parents(cache_dir, 0775);
+    probes_data.path = g_build_filename(cache_dir, PROBES_CACHE_FILE, NULL);
+    readahead_note_file(probes_data.path);
+    probes_data.cache = g_key_file_new();
+
+    GError* error = NULL;
+    g_key_file_load_from_file(probes_data.cache, probes_data.path, G_KEY_FILE_NONE, &error);
+    if(error && !g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning("Failed to load probes cache from %s: %s", probes_data.path, error->message);
+    g_clear_error(&error);
+
+    /* Programs could be installed or removed since cache was written */
+    gchar* stamp = get_path_stamp();
+    gchar* cached_stamp = g_key_file_get_string(probes_data.cache, STAMPS_GROUP, PROGRAMS_GROUP, NULL);
+    if(g_strcmp0(stamp, cached_stamp) != 0)
+    {
+        g_key_file_remove_group(probes_data.cache, PROGRAMS_GROUP, NULL);
+        g_key_file_set_string(probes_data.cache, STAMPS_GROUP, PROGRAMS_GROUP, stamp);
+    }
+    g_free(cached_stamp);
+    g_free(stamp);
+    g_free(cache_dir);
+    return probes_data.cache;
+}
+
+/* Directory mtime changes when files are added to it or removed */
+static gchar* get_path_stamp(void)
+{
+    const gchar* path_env = g_getenv("PATH");
+    GString* stamp = g_string_new(path_env);
+    gchar** dirs = g_strsplit(path_env ? path_env : "", G_SEARCHPATH_SEPARATOR_S, -1);
+    for(gchar** dir = dirs; *dir; ++dir)
+    {
+        GStatBuf st;
+        g_string_append_printf(stamp, ";%" G_GINT64_FORMAT,
+                               g_stat(*dir, &st) == 0 ? (gint64)st.st_mtime : (gint64)-1);
+    }
+    g_strfreev(dirs);
+    return g_string_free(stamp, FALSE);
+}
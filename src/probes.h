@@ -0,0 +1,58 @@
+/* probes.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _PROBES_H_INCLUDED_
+#define _PROBES_H_INCLUDED_
+
+#include <gtk/gtk.h>
+#include <X11/Xlib.h>
+
+#include "shares.h"
+
+/* Types */
+
+/* path: full path to executable, NULL if it is not found */
+typedef void (*ProgramProbeCallback)   (const gchar* name,
+                                        const gchar* path,
+                                        gpointer data);
+/* allowed: POWER_ACTIONS_COUNT items */
+typedef void (*PowerProbeCallback)     (const gboolean* allowed,
+                                        gpointer data);
+/* display: new connection with XKB extension initialized, NULL if XKB is not available */
+typedef void (*XkbProbeCallback)       (Display* display,
+                                        gpointer data);
+
+/* Functions */
+
+/* Programs and power actions are probed in worker threads, XKB display is opened in main loop
+   with low priority. Callbacks are called from main loop */
+void probe_program                     (const gchar* name,
+                                        ProgramProbeCallback callback,
+                                        gpointer data);
+void probe_power_actions               (PowerProbeCallback callback,
+                                        gpointer data);
+void probe_xkb_display                 (XkbProbeCallback callback,
+                                        gpointer data);
+
+/* Search for executable in PATH, result is cached with mtimes of PATH directories.
+   Thread safe, but may block on first call */
+gchar* find_program                    (const gchar* name);
+
+#endif // _PROBES_H_INCLUDED_
@@ -0,0 +1,166 @@
+/* readahead.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "shares.h"
+#include "configuration.h"
+#include "readahead.h"
+
+/* Static constants */
+
+static const gchar* const READAHEAD_MANIFEST = "readahead";
+static const gint READAHEAD_THREADS = 4;
+
+/* Static variables */
+
+static struct
+{
+    GMutex      lock;
+    /* HashSet<path> of files read since start */
+    GHashTable* files;
+} readahead_data;
+
+/* Static functions */
+
+static gchar* get_manifest_path                 (void);
+static void readahead_file                      (gchar* path,
+                                                 gpointer dummy);
+static void note_mapped_files                   (void);
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void readahead_replay(void)
+{
+    gchar* path = get_manifest_path();
+    gchar* contents = NULL;
+    gboolean loaded = g_file_get_contents(path, &contents, NULL, NULL);
+    g_free(path);
+    if(!loaded)
+        return;
+
+    GThreadPool* pool = g_thread_pool_new((GFunc)readahead_file, NULL, READAHEAD_THREADS, FALSE, NULL);
+    gchar** files = g_strsplit(contents, "\n", -1);
+    for(gchar** file = files; *file; ++file)
+        if(**file)
+            g_thread_pool_push(pool, g_strdup(*file), NULL);
+    /* Pool is freed when all files are processed */
+    g_thread_pool_free(pool, FALSE, FALSE);
+    g_strfreev(files);
+    g_free(contents);
+}
+
+void readahead_note_file(const gchar* path)
+{
+    if(!path || !g_path_is_absolute(path))
+        return;
+    g_mutex_lock(&readahead_data.lock);
+    if(!readahead_data.files)
+        readahead_data.files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    if(!g_hash_table_contains(readahead_data.files, path))
+        g_hash_table_add(readahead_data.files, g_strdup(path));
+    g_mutex_unlock(&readahead_data.lock);
+}
+
+void readahead_record(void)
+{
+    gchar* path = get_manifest_path();
+    if(!config.greeter.readahead)
+    {
+        g_unlink(path);
+        g_free(path);
+        return;
+    }
+
+    note_mapped_files();
+
+    GString* manifest = g_string_new(NULL);
+    g_mutex_lock(&readahead_data.lock);
+    if(readahead_data.files)
+    {
+        GHashTableIter iter;
+        const gchar* file;
+        g_hash_table_iter_init(&iter, readahead_data.files);
+        while(g_hash_table_iter_next(&iter, (gpointer*)&file, NULL))
+            if(g_file_test(file, G_FILE_TEST_IS_REGULAR))
+                g_string_append_printf(manifest, "%s\n", file);
+    }
+    g_mutex_unlock(&readahead_data.lock);
+
+    GError* error = NULL;
+    if(!g_file_set_contents(path, manifest->str, manifest->len, &error))
+    {
+        g_warning("Failed to save readahead manifest: %s", error->message);
+        g_clear_error(&error);
+    }
+    else
+        g_debug("Readahead manifest saved: %s", path);
+    g_string_free(manifest, TRUE);
+    g_free(path);
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static gchar* get_manifest_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), APP_NAME, READAHEAD_MANIFEST, NULL);
+}
+
+static void readahead_file(gchar* path,
+                           gpointer dummy)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd >= 0)
+    {
+        /* Asynchronous: kernel starts reading whole file and returns */
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+    g_free(path);
+}
+
+/* Libraries, fonts, locale archive, icon caches and other mapped files */
+static void note_mapped_files(void)
+{
+    gchar* maps = NULL;
+    if(!g_file_get_contents("/proc/self/maps", &maps, NULL, NULL))
+        return;
+
+    gchar** lines = g_strsplit(maps, "\n", -1);
+    for(gchar** line = lines; *line; ++line)
+    {
+        const gchar* path = strchr(*line, '/');
+        if(path && !g_str_has_suffix(path, " (deleted)") &&
+           !g_str_has_prefix(path, "/dev/") && !g_str_has_prefix(path, "/memfd:"))
+            readahead_note_file(path);
+    }
+    g_strfreev(lines);
+    g_free(maps);
+}
@@ -0,0 +1,34 @@
+/* readahead.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _READAHEAD_H_INCLUDED_
+#define _READAHEAD_H_INCLUDED_
+
+#include <glib.h>
+
+/* Functions */
+
+/* Starts background readahead of files listed in manifest, must be called first in main() */
+void readahead_replay                  (void);
+/* Remembers file read by greeter, thread safe */
+void readahead_note_file               (const gchar* path);
+/* Saves manifest: noted and currently mapped files. Removes manifest if readahead is disabled */
+void readahead_record                  (void);
+
+#endif // _READAHEAD_H_INCLUDED_
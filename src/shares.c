@@ -59,12 +59,29 @@ typedef struct
     gint id;
 } MessageBoxButtonRunInfo;
 
+/* Static variables */
+
+/* Layout requests are coalesced and applied once per frame */
+static struct
+{
+    GdkFrameClock* clock;
+    gulong         layout_id;
+    /* main_layout allocation used for last positioning */
+    GtkAllocation  layout_allocation;
+    gboolean       watching_layout;
+} main_window_layout;
+
 /* Static functions */
 
 static gint get_absolute_windows_position   (const WindowPositionDimension* p,
                                              gint                           screen,
                                              gint                           window);
 
+static gint run_message_dialog              (const gchar*                title,
+                                             const gchar*                message,
+                                             const MessageButtonOptions* buttons,
+                                             gint                        default_id,
+                                             gint                        cancel_id);
 static void stop_messagebox_loop            (MessageBoxRunInfo* info,
                                              gint               response);
 static gboolean on_messagebox_key_press     (GtkWidget*         widget,
@@ -73,6 +90,13 @@ static gboolean on_messagebox_key_press     (GtkWidget*         widget,
 static void on_messagebox_button_clicked    (GtkWidget*               widget,
                                              MessageBoxButtonRunInfo* button_info);
 
+static void apply_main_window_layout        (void);
+static void on_main_window_layout_frame     (GdkFrameClock* clock,
+                                             gpointer       data);
+static void on_main_layout_size_allocate    (GtkWidget*     widget,
+                                             GdkRectangle*  allocation,
+                                             gpointer       data);
+
 /* ---------------------------------------------------------------------------*
  * Definitions: public
  * -------------------------------------------------------------------------- */
@@ -134,6 +158,14 @@ gint show_message(const gchar*                title,
     g_vasprintf(&message, _(message_format), argptr);
     va_end(argptr);
 
+    if(!load_ui_fragment(UI_FRAGMENT_MESSAGEBOX))
+    {
+        gint response = run_message_dialog(_(title), message, buttons, default_id, cancel_id);
+        g_free(message);
+        g_main_loop_unref(info.loop);
+        return response;
+    }
+
     clear_container(GTK_CONTAINER(greeter.ui.messagebox_buttons));
     for(const MessageButtonOptions* button = buttons; button->id != GTK_RESPONSE_NONE; ++button)
     {
@@ -463,33 +495,29 @@ void update_main_window_layout(void)
     if(greeter.ui.main_layout == greeter.ui.main_content ||
        !GTK_IS_FIXED(greeter.ui.main_layout))
         return;
-    const WindowPosition* p = &config.appearance.position;
-    GdkScreen* screen = gtk_window_get_screen(GTK_WINDOW(greeter.ui.screen_window));
-    GtkAllocation size, size_layout;
-    GdkRectangle geometry;
-    gint x, y;
 
-    gtk_container_check_resize(GTK_CONTAINER(greeter.ui.screen_layout));
-    gtk_widget_get_allocation(greeter.ui.main_content, &size);
-    gtk_widget_get_allocation(greeter.ui.main_layout, &size_layout);
-    if(config.appearance.position_is_relative)
-        geometry = (GtkAllocation){.x = 0, .y = 0, .width = size_layout.width, .height = size_layout.height};
-    else
-        gdk_screen_get_monitor_geometry(screen, gdk_screen_get_primary_monitor(screen), &geometry);
+    /* Not realized yet: first frame will allocate main_content and call us again */
+    GdkFrameClock* clock = gtk_widget_get_frame_clock(greeter.ui.screen_window);
+    if(!clock)
+        return;
 
-    x = get_absolute_windows_position(&p->x, geometry.width, size.width);
-    y = get_absolute_windows_position(&p->y, geometry.height, size.height);
+    if(!main_window_layout.watching_layout)
+    {
+        g_signal_connect(greeter.ui.main_layout, "size-allocate",
+                         G_CALLBACK(on_main_layout_size_allocate), NULL);
+        main_window_layout.watching_layout = TRUE;
+    }
 
-    if(!config.appearance.position_is_relative)
-        gtk_widget_translate_coordinates(greeter.ui.screen_window, greeter.ui.main_layout,
-                                         x, y, &x, &y);
-    /* TODO: creepy moving fix (F1) */
-    if(y + size.height > size_layout.height)
-        y = size_layout.height - size.height - 2;
-    if(y < 0)
-        y = 0;
-    gtk_fixed_move(GTK_FIXED(greeter.ui.main_layout), greeter.ui.main_content, x, y);
-    gtk_container_check_resize(GTK_CONTAINER(greeter.ui.screen_layout));
+    if(main_window_layout.layout_id)
+    {
+        if(main_window_layout.clock == clock)
+            return;
+        g_signal_handler_disconnect(main_window_layout.clock, main_window_layout.layout_id);
+    }
+    main_window_layout.clock = clock;
+    main_window_layout.layout_id = g_signal_connect(clock, "layout",
+                                                    G_CALLBACK(on_main_window_layout_frame), NULL);
+    gdk_frame_clock_request_phase(clock, GDK_FRAME_CLOCK_PHASE_LAYOUT);
 }
 
 void focus_main_window(void)
@@ -529,6 +557,92 @@ static gint get_absolute_windows_position(const WindowPositionDimension* p,
     return x;
 }
 
+static void apply_main_window_layout(void)
+{
+    const WindowPosition* p = &config.appearance.position;
+    GdkScreen* screen = gtk_window_get_screen(GTK_WINDOW(greeter.ui.screen_window));
+    GtkRequisition size;
+    GtkAllocation size_layout;
+    GdkRectangle geometry;
+    gint x, y;
+
+    /* GtkFixed allocates minimal size to its children, so requisition is valid even if
+       main_content is not allocated yet */
+    gtk_widget_get_preferred_size(greeter.ui.main_content, &size, NULL);
+    gtk_widget_get_allocation(greeter.ui.main_layout, &size_layout);
+    main_window_layout.layout_allocation = size_layout;
+
+    if(config.appearance.position_is_relative)
+        geometry = (GtkAllocation){.x = 0, .y = 0, .width = size_layout.width, .height = size_layout.height};
+    else
+        gdk_screen_get_monitor_geometry(screen, gdk_screen_get_primary_monitor(screen), &geometry);
+
+    x = get_absolute_windows_position(&p->x, geometry.width, size.width);
+    y = get_absolute_windows_position(&p->y, geometry.height, size.height);
+
+    if(!config.appearance.position_is_relative)
+        gtk_widget_translate_coordinates(greeter.ui.screen_window, greeter.ui.main_layout,
+                                         x, y, &x, &y);
+    /* TODO: creepy moving fix (F1) */
+    if(y + size.height > size_layout.height)
+        y = size_layout.height - size.height - 2;
+    if(y < 0)
+        y = 0;
+
+    gint old_x, old_y;
+    gtk_container_child_get(GTK_CONTAINER(greeter.ui.main_layout), greeter.ui.main_content,
+                            "x", &old_x, "y", &old_y, NULL);
+    if(x != old_x || y != old_y)
+        gtk_fixed_move(GTK_FIXED(greeter.ui.main_layout), greeter.ui.main_content, x, y);
+}
+
+static void on_main_window_layout_frame(GdkFrameClock* clock,
+                                       gpointer       data)
+{
+    g_signal_handler_disconnect(clock, main_window_layout.layout_id);
+    main_window_layout.layout_id = 0;
+    main_window_layout.clock = NULL;
+    apply_main_window_layout();
+}
+
+static void on_main_layout_size_allocate(GtkWidget*    widget,
+                                         GdkRectangle* allocation,
+                                         gpointer      data)
+{
+    if(allocation->width != main_window_layout.layout_allocation.width ||
+       allocation->height != main_window_layout.layout_allocation.height)
+        update_main_window_layout();
+}
+
+/* Fallback for show_message() if messagebox can not be loaded */
+static gint run_message_dialog(const gchar*                title,
+                               const gchar*                message,
+                               const MessageButtonOptions* buttons,
+                               gint                        default_id,
+                               gint                        cancel_id)
+{
+    GtkWidget* dialog = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_QUESTION, GTK_BUTTONS_NONE,
+                                               "%s", message);
+    for(const MessageButtonOptions* button = buttons; button->id != GTK_RESPONSE_NONE; ++button)
+        gtk_dialog_add_button(GTK_DIALOG(dialog), button->text, button->id);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), default_id);
+
+    gtk_widget_hide(greeter.ui.screen_layout);
+    gtk_widget_set_name(dialog, "dialog_window_question");
+    gtk_window_set_title(GTK_WINDOW(dialog), title);
+    set_window_position(dialog, &WINDOW_POSITION_CENTER);
+    gtk_widget_show_all(dialog);
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+    gtk_widget_show(greeter.ui.screen_layout);
+    focus_main_window();
+
+    /* Dialog closed without choosing a button */
+    if(response == GTK_RESPONSE_DELETE_EVENT || response == GTK_RESPONSE_NONE)
+        response = cancel_id;
+    return response;
+}
+
 static void stop_messagebox_loop(MessageBoxRunInfo* info,
                                  gint               response)
 {
@@ -57,7 +57,10 @@ typedef struct
     LightDMGreeter* greeter;
     struct
     {
+        /* HashTable<display name, UserRowInfo*>: first of users with same name, see UserRowInfo */
         GHashTable*     users_display_names;
+        /* HashTable<user name, UserRowInfo*> */
+        GHashTable*     users_rows;
         gboolean        prompted;
         gboolean        cancelling;
         const gchar*    last_background;
@@ -75,13 +78,30 @@ typedef struct
         gboolean        password_required;
         gboolean        show_password;
         GdkPixbuf*      window_background;
+        /* Server-side copy of window_background, replaces it in idle mode */
+        cairo_surface_t* window_background_surface;
         gboolean        no_users_list;
+        /* Users list contains only recently logged in users (recent-users-limit) */
+        gboolean        recent_users_only;
+        /* Session start request is sent, waiting for LightDM response */
+        gboolean        starting_session;
+
+        /* Sessions and languages models contain only selected item until full list is loaded */
+        struct
+        {
+            gboolean    loaded;
+            /* set_session()/set_language() was called before loading, reapply it after */
+            gboolean    pending;
+            gchar*      requested;
+        } sessions, languages;
 
         struct
         {
             gboolean    gtk_theme_applied;
-            /* Style providers applied in apply_gtk_theme */
+            /* Style providers applied in apply_gtk_theme, owned by style_variants */
             GSList*     style_providers;
+            /* HashTable<gtk theme name, GSList<GtkStyleProvider*>>: parsed CSS of themes stack for every used Gtk theme */
+            GHashTable* style_variants;
         } theming;
     } state;
 
@@ -260,6 +280,15 @@ enum
     UI_LAYOUT_ROW_PANEL_BOTTOM,
 };
 
+typedef enum
+{
+    /* Main UI file, loaded at startup */
+    UI_FRAGMENT_MAIN = 0,
+    UI_FRAGMENT_MESSAGEBOX,
+    UI_FRAGMENT_ONBOARD,
+    UI_FRAGMENTS_COUNT
+} UIFragment;
+
 typedef GtkWidget* (*NewWidgetFunc)(void);
 
 /* Variables */
@@ -333,9 +362,14 @@ void set_widget_toggled                (GtkWidget* widget,
                                         gboolean   state,
                                         GCallback  suppress_callback);
 void clear_container                   (GtkContainer* container);
-/* Set positions of main window according to settings and current program state */
+/* Set positions of main window according to settings and current program state.
+   Requests are coalesced and applied in layout phase of next frame */
 void update_main_window_layout         (void);
 void focus_main_window                 (void);
+/* Build part of UI from its own file if main UI file does not contain it */
+gboolean load_ui_fragment              (UIFragment fragment);
+/* Replace client-side background pixbuf with server-side surface */
+void release_window_background         (void);
 
 void free_model_property_binding       (gpointer data);
 
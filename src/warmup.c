@@ -0,0 +1,185 @@
+/* warmup.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <gtk/gtk.h>
+#include <fontconfig/fontconfig.h>
+
+#include "shares.h"
+#include "configuration.h"
+#include "indicator_a11y.h"
+#include "warmup.h"
+
+/* Types */
+
+typedef struct
+{
+    /* Fonts to resolve */
+    gchar** fonts;
+    /* Icon themes to read caches of */
+    gchar** icon_themes;
+    /* Other files to read */
+    gchar** files;
+} WarmupData;
+
+/* Static constants */
+
+/* Fallback themes used by Gtk for every lookup */
+static const gchar* const DEFAULT_ICON_THEMES[] = {"hicolor", "Adwaita", NULL};
+
+/* Static functions */
+
+static gpointer warmup_thread                   (WarmupData* data);
+static void warmup_font                         (const gchar* font_name);
+static void warmup_file                         (const gchar* path);
+static void free_warmup_data                    (WarmupData* data);
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void start_warmup(void)
+{
+    WarmupData* data = g_malloc0(sizeof(WarmupData));
+    GPtrArray* fonts = g_ptr_array_new();
+    GPtrArray* icon_themes = g_ptr_array_new();
+    GPtrArray* files = g_ptr_array_new();
+
+    g_ptr_array_add(fonts, a11y_get_font_name(FALSE));
+    if(config.a11y.enabled && config.a11y.font.enabled)
+        g_ptr_array_add(fonts, a11y_get_font_name(TRUE));
+    g_ptr_array_add(fonts, NULL);
+
+    if(config.appearance.icon_theme)
+        g_ptr_array_add(icon_themes, g_strdup(config.appearance.icon_theme));
+    if(config.a11y.enabled && config.a11y.contrast.enabled && config.a11y.contrast.icon_theme)
+        g_ptr_array_add(icon_themes, g_strdup(config.a11y.contrast.icon_theme));
+    for(const gchar* const* theme = DEFAULT_ICON_THEMES; *theme; ++theme)
+        g_ptr_array_add(icon_themes, g_strdup(*theme));
+    g_ptr_array_add(icon_themes, NULL);
+
+    if(config.greeter.show_session_icon)
+        g_ptr_array_add(files, g_build_filename(g_get_user_cache_dir(), APP_NAME, "session-images.png", NULL));
+    if(config.appearance.default_user_image && config.appearance.default_user_image[0] != '#')
+        g_ptr_array_add(files, g_strdup(config.appearance.default_user_image));
+    g_ptr_array_add(files, NULL);
+
+    data->fonts = (gchar**)g_ptr_array_free(fonts, FALSE);
+    data->icon_themes = (gchar**)g_ptr_array_free(icon_themes, FALSE);
+    data->files = (gchar**)g_ptr_array_free(files, FALSE);
+
+    GError* error = NULL;
+    GThread* thread = g_thread_try_new("warmup", (GThreadFunc)warmup_thread, data, &error);
+    if(thread)
+        g_thread_unref(thread);
+    else
+    {
+        g_warning("Failed to start warm-up thread: %s", error->message);
+        g_clear_error(&error);
+        free_warmup_data(data);
+    }
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static gpointer warmup_thread(WarmupData* data)
+{
+    gint64 start_time = g_get_monotonic_time();
+
+    /* Fontconfig configuration and caches are shared by whole process */
+    FcInit();
+    for(gchar** font = data->fonts; *font; ++font)
+        warmup_font(*font);
+
+    /* GtkIconTheme is not thread safe: only caches used by it are read here */
+    const gchar* const* data_dirs = g_get_system_data_dirs();
+    for(gchar** theme = data->icon_themes; *theme; ++theme)
+        for(const gchar* const* dir = data_dirs; *dir; ++dir)
+        {
+            gchar* index_path = g_build_filename(*dir, "icons", *theme, "index.theme", NULL);
+            gchar* cache_path = g_build_filename(*dir, "icons", *theme, "icon-theme.cache", NULL);
+            warmup_file(index_path);
+            warmup_file(cache_path);
+            g_free(cache_path);
+            g_free(index_path);
+        }
+
+    for(gchar** file = data->files; *file; ++file)
+        warmup_file(*file);
+
+    g_debug("Warm-up finished in %" G_GINT64_FORMAT " ms", (g_get_monotonic_time() - start_time)/1000);
+    free_warmup_data(data);
+    return NULL;
+}
+
+static void warmup_font(const gchar* font_name)
+{
+    if(!font_name)
+        return;
+
+    PangoFontDescription* description = pango_font_description_from_string(font_name);
+    FcPattern* pattern = FcPatternCreate();
+    if(pango_font_description_get_family(description))
+        FcPatternAddString(pattern, FC_FAMILY, (const FcChar8*)pango_font_description_get_family(description));
+    if(pango_font_description_get_size(description) > 0)
+        FcPatternAddDouble(pattern, FC_SIZE, (double)pango_font_description_get_size(description)/PANGO_SCALE);
+
+    FcConfigSubstitute(NULL, pattern, FcMatchPattern);
+    FcDefaultSubstitute(pattern);
+    FcResult result;
+    FcPattern* match = FcFontMatch(NULL, pattern, &result);
+    if(match)
+    {
+        FcChar8* file = NULL;
+        if(FcPatternGetString(match, FC_FILE, 0, &file) == FcResultMatch)
+            warmup_file((const gchar*)file);
+        FcPatternDestroy(match);
+    }
+    FcPatternDestroy(pattern);
+    pango_font_description_free(description);
+}
+
+/* Reads file to get it into page cache */
+static void warmup_file(const gchar* path)
+{
+    GMappedFile* file = g_mapped_file_new(path, FALSE, NULL);
+    if(!file)
+        return;
+
+    /* Touch every page */
+    const gchar* contents = g_mapped_file_get_contents(file);
+    gsize length = g_mapped_file_get_length(file);
+    volatile gchar sum = 0;
+    for(gsize i = 0; i < length; i += 4096)
+        sum += contents[i];
+    g_mapped_file_unref(file);
+}
+
+static void free_warmup_data(WarmupData* data)
+{
+    g_strfreev(data->fonts);
+    g_strfreev(data->icon_themes);
+    g_strfreev(data->files);
+    g_free(data);
+}
@@ -0,0 +1,276 @@
+/* watchdog.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include <glib/gstdio.h>
+#ifdef HAVE_EXECINFO_H
+    #include <execinfo.h>
+#endif
+
+#include "shares.h"
+#include "configuration.h"
+#include "watchdog.h"
+
+/* Static constants */
+
+static const gchar* const WATCHDOG_LOG          = "watchdog.log";
+/* Log is renamed to WATCHDOG_LOG.1 when it grows over this size */
+static const goffset WATCHDOG_LOG_MAX_SIZE      = 64*1024;
+#define WATCHDOG_MAX_DEPTH                      8
+#define WATCHDOG_BACKTRACE_SIZE                 64
+/* Time to wait for main thread backtrace, ms */
+static const guint WATCHDOG_BACKTRACE_TIMEOUT   = 100;
+/* Polling interval while main loop is stalled, ms */
+static const guint WATCHDOG_STALL_POLL          = 10;
+#define WATCHDOG_BACKTRACE_SIGNAL               SIGUSR2
+
+/* Static variables */
+
+static struct
+{
+    GThread*     thread;
+    GThread*     main_thread;
+    pthread_t    main_pthread;
+    GMutex       mutex;
+    GCond        cond;
+    gboolean     paused;
+    /* Heartbeats sent by watchdog thread and acknowledged by main loop */
+    gint         beat_sent;
+    gint         beat_received;
+    /* Operations of main thread, written by main thread only */
+    const gchar* operations[WATCHDOG_MAX_DEPTH];
+    gint         depth;
+    #ifdef HAVE_EXECINFO_H
+    void*        backtrace[WATCHDOG_BACKTRACE_SIZE];
+    /* Set by signal handler, -1 if backtrace is not captured */
+    gint         backtrace_size;
+    #endif
+} watchdog;
+
+/* Static functions */
+
+static gboolean start_watchdog_thread           (gpointer data);
+static gpointer watchdog_thread                 (gpointer data);
+static gboolean on_heartbeat                    (gpointer beat);
+static void write_report                        (gint64 duration,
+                                                 const gchar* operation,
+                                                 gboolean with_backtrace);
+static FILE* open_log                           (void);
+#ifdef HAVE_EXECINFO_H
+static gboolean capture_backtrace               (void);
+static void on_backtrace_signal                 (int signum);
+#endif
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void start_watchdog(void)
+{
+    watchdog.main_thread = g_thread_self();
+    if(config.greeter.watchdog_threshold <= 0)
+        return;
+
+    watchdog.main_pthread = pthread_self();
+    #ifdef HAVE_EXECINFO_H
+    if(config.greeter.watchdog_backtrace)
+    {
+        /* First call of backtrace() loads libgcc, it must not happen in signal handler */
+        backtrace(watchdog.backtrace, WATCHDOG_BACKTRACE_SIZE);
+        struct sigaction action = {.sa_handler = on_backtrace_signal, .sa_flags = SA_RESTART};
+        sigemptyset(&action.sa_mask);
+        sigaction(WATCHDOG_BACKTRACE_SIGNAL, &action, NULL);
+    }
+    #endif
+
+    g_mutex_init(&watchdog.mutex);
+    g_cond_init(&watchdog.cond);
+    /* Startup before main loop is not a stall */
+    g_idle_add(start_watchdog_thread, NULL);
+}
+
+void watchdog_pause(void)
+{
+    if(!watchdog.thread)
+        return;
+    g_mutex_lock(&watchdog.mutex);
+    watchdog.paused = TRUE;
+    g_mutex_unlock(&watchdog.mutex);
+}
+
+void watchdog_resume(void)
+{
+    if(!watchdog.thread)
+        return;
+    g_mutex_lock(&watchdog.mutex);
+    watchdog.paused = FALSE;
+    g_cond_signal(&watchdog.cond);
+    g_mutex_unlock(&watchdog.mutex);
+}
+
+void watchdog_enter(const gchar* operation)
+{
+    if(g_thread_self() != watchdog.main_thread)
+        return;
+    gint depth = g_atomic_int_get(&watchdog.depth);
+    if(depth < WATCHDOG_MAX_DEPTH)
+        watchdog.operations[depth] = operation;
+    g_atomic_int_set(&watchdog.depth, depth + 1);
+}
+
+void watchdog_leave(void)
+{
+    if(g_thread_self() != watchdog.main_thread)
+        return;
+    g_return_if_fail(g_atomic_int_get(&watchdog.depth) > 0);
+    g_atomic_int_add(&watchdog.depth, -1);
+}
+
+void watchdog_leave_scope(const gchar** operation)
+{
+    watchdog_leave();
+}
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: static
+ * -------------------------------------------------------------------------- */
+
+static gboolean start_watchdog_thread(gpointer data)
+{
+    g_message("Watchdog: reporting main loop stalls longer than %d ms", config.greeter.watchdog_threshold);
+    watchdog.thread = g_thread_new("watchdog", watchdog_thread, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer watchdog_thread(gpointer data)
+{
+    const gint64 threshold = config.greeter.watchdog_threshold;
+    for(;;)
+    {
+        g_mutex_lock(&watchdog.mutex);
+        while(watchdog.paused)
+            g_cond_wait(&watchdog.cond, &watchdog.mutex);
+        g_mutex_unlock(&watchdog.mutex);
+
+        const gint beat = ++watchdog.beat_sent;
+        g_idle_add_full(G_PRIORITY_HIGH, on_heartbeat, GINT_TO_POINTER(beat), NULL);
+        const gint64 sent_time = g_get_monotonic_time();
+        g_usleep(threshold*1000);
+        if(g_atomic_int_get(&watchdog.beat_received) == beat)
+            continue;
+
+        /* Main loop is stalled now, operation is taken before it can finish */
+        const gint depth = g_atomic_int_get(&watchdog.depth);
+        const gchar* operation = depth > 0 ? watchdog.operations[MIN(depth, WATCHDOG_MAX_DEPTH) - 1] : NULL;
+        gboolean with_backtrace = FALSE;
+        #ifdef HAVE_EXECINFO_H
+        if(config.greeter.watchdog_backtrace)
+            with_backtrace = capture_backtrace();
+        #endif
+
+        while(g_atomic_int_get(&watchdog.beat_received) != beat)
+            g_usleep(WATCHDOG_STALL_POLL*1000);
+        write_report((g_get_monotonic_time() - sent_time)/1000, operation, with_backtrace);
+    }
+    return NULL;
+}
+
+static gboolean on_heartbeat(gpointer beat)
+{
+    g_atomic_int_set(&watchdog.beat_received, GPOINTER_TO_INT(beat));
+    return G_SOURCE_REMOVE;
+}
+
+static void write_report(gint64 duration,
+                         const gchar* operation,
+                         gboolean with_backtrace)
+{
+    g_warning("Watchdog: main loop stalled for %" G_GINT64_FORMAT " ms (%s)",
+              duration, operation ? operation : "unknown operation");
+
+    FILE* log = open_log();
+    if(!log)
+        return;
+
+    GDateTime* datetime = g_date_time_new_now_local();
+    gchar* time_str = datetime ? g_date_time_format(datetime, "%F %T") : NULL;
+    fprintf(log, "%s: stalled for %" G_GINT64_FORMAT " ms in %s\n",
+            time_str ? time_str : "?", duration, operation ? operation : "unknown operation");
+    #ifdef HAVE_EXECINFO_H
+    if(with_backtrace)
+    {
+        fflush(log);
+        backtrace_symbols_fd(watchdog.backtrace, g_atomic_int_get(&watchdog.backtrace_size), fileno(log));
+    }
+    #endif
+    fclose(log);
+    g_free(time_str);
+    if(datetime)
+        g_date_time_unref(datetime);
+}
+
+static FILE* open_log(void)
+{
+    gchar* cache_dir = g_build_filename(g_get_user_cache_dir(), APP_NAME, NULL);
+    gchar* path = g_build_filename(cache_dir, WATCHDOG_LOG, NULL);
+    GStatBuf st;
+    if(g_stat(path, &st) == 0 && st.st_size > WATCHDOG_LOG_MAX_SIZE)
+    {
+        gchar* old_path = g_strconcat(path, ".1", NULL);
+        g_rename(path, old_path);
+        g_free(old_path);
+    }
+
+    FILE* log = NULL;
+    if(g_mkdir_with_parents(cache_dir, 0755) == 0)
+        log = g_fopen(path, "a");
+    if(!log)
+        g_warning("Watchdog: failed to open log file: %s", path);
+    g_free(path);
+    g_free(cache_dir);
+    return log;
+}
+
+#ifdef HAVE_EXECINFO_H
+static gboolean capture_backtrace(void)
+{
+    g_atomic_int_set(&watchdog.backtrace_size, -1);
+    if(pthread_kill(watchdog.main_pthread, WATCHDOG_BACKTRACE_SIGNAL) != 0)
+        return FALSE;
+    for(guint waited = 0; waited < WATCHDOG_BACKTRACE_TIMEOUT; waited += WATCHDOG_STALL_POLL)
+    {
+        if(g_atomic_int_get(&watchdog.backtrace_size) >= 0)
+            return TRUE;
+        g_usleep(WATCHDOG_STALL_POLL*1000);
+    }
+    return FALSE;
+}
+
+/* Runs in main thread */
+static void on_backtrace_signal(int signum)
+{
+    g_atomic_int_set(&watchdog.backtrace_size, backtrace(watchdog.backtrace, WATCHDOG_BACKTRACE_SIZE));
+}
+#endif
@@ -0,0 +1,45 @@
+/* watchdog.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _WATCHDOG_H_INCLUDED_
+#define _WATCHDOG_H_INCLUDED_
+
+#include <glib.h>
+
+/* Functions */
+
+/* Report main loop stalls longer than greeter/watchdog-threshold.
+   Must be called from main thread, checking starts with main loop */
+void start_watchdog                    (void);
+/* No heartbeats are sent while paused */
+void watchdog_pause                    (void);
+void watchdog_resume                   (void);
+
+/* Mark operation of main thread to report it if main loop stalls inside of it */
+void watchdog_enter                    (const gchar* operation);
+void watchdog_leave                    (void);
+void watchdog_leave_scope              (const gchar** operation);
+
+/* Marks operation until the end of current block */
+#define WATCHDOG_OPERATION(name) \
+    __attribute__((cleanup(watchdog_leave_scope))) const gchar* _watchdog_operation_ = name; \
+    watchdog_enter(_watchdog_operation_)
+
+#endif // _WATCHDOG_H_INCLUDED_
@@ -0,0 +1,101 @@
+/* x11_utils.c
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DEBUG_
+    #include "config.h"
+#endif
+
+#include <gdk/gdkx.h>
+
+#include "x11_utils.h"
+
+/* Static constants */
+
+static const gchar* const ATOM_NAMES[X11_ATOMS_COUNT] =
+{
+    [X11_ATOM_XROOTPMAP_ID]     = "_XROOTPMAP_ID",
+    [X11_ATOM_ESETROOT_PMAP_ID] = "ESETROOT_PMAP_ID",
+    [X11_ATOM_XKB_RULES_NAMES]  = "_XKB_RULES_NAMES"
+};
+
+/* Static variables */
+
+static struct
+{
+    Display*     display;
+    Atom         atoms[X11_ATOMS_COUNT];
+    /* Updated from worker threads too */
+    gint         round_trips;
+
+    struct
+    {
+        const gchar* name;
+        /* Nested phases are counted as part of outer one */
+        guint        depth;
+        gint64       start_time;
+        gint         round_trips;
+        gulong       first_request;
+    } phase;
+} x11_data;
+
+/* ---------------------------------------------------------------------------*
+ * Definitions: public
+ * -------------------------------------------------------------------------- */
+
+void x11_init(void)
+{
+    x11_data.display = gdk_x11_get_default_xdisplay();
+    if(!XInternAtoms(x11_data.display, (char**)ATOM_NAMES, X11_ATOMS_COUNT, False, x11_data.atoms))
+        g_warning("X11: failed to intern atoms");
+    x11_count_round_trip(1);
+}
+
+Atom x11_get_atom(X11Atom atom)
+{
+    g_return_val_if_fail(atom >= 0 && atom < X11_ATOMS_COUNT, None);
+    return x11_data.atoms[atom];
+}
+
+void x11_count_round_trip(guint count)
+{
+    g_atomic_int_add(&x11_data.round_trips, (gint)count);
+}
+
+void x11_phase_begin(const gchar* name)
+{
+    if(x11_data.phase.depth++ > 0)
+        return;
+    x11_data.phase.name = name;
+    x11_data.phase.start_time = g_get_monotonic_time();
+    x11_data.phase.round_trips = g_atomic_int_get(&x11_data.round_trips);
+    x11_data.phase.first_request = NextRequest(x11_data.display);
+}
+
+void x11_phase_end(void)
+{
+    g_return_if_fail(x11_data.phase.depth > 0);
+    if(--x11_data.phase.depth > 0)
+        return;
+    /* Requests counter is for GDK connection only, round trips are counted for all connections */
+    g_message("%s finished in %" G_GINT64_FORMAT " ms: %lu X11 requests, %d round trips by greeter",
+              x11_data.phase.name, (g_get_monotonic_time() - x11_data.phase.start_time)/1000,
+              NextRequest(x11_data.display) - x11_data.phase.first_request,
+              g_atomic_int_get(&x11_data.round_trips) - x11_data.phase.round_trips);
+    x11_data.phase.name = NULL;
+}
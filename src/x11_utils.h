@@ -0,0 +1,50 @@
+/* x11_utils.h
+ *
+ * Copyright (C) 2012 Paddubsky A.V. <pan.pav.7c5@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef _X11_UTILS_H_INCLUDED_
+#define _X11_UTILS_H_INCLUDED_
+
+#include <glib.h>
+#include <X11/Xlib.h>
+
+/* Types */
+
+typedef enum
+{
+    X11_ATOM_XROOTPMAP_ID,
+    X11_ATOM_ESETROOT_PMAP_ID,
+    X11_ATOM_XKB_RULES_NAMES,
+    X11_ATOMS_COUNT
+} X11Atom;
+
+/* Functions */
+
+/* Intern all atoms used by greeter with one request, must be called after gtk_init() */
+void x11_init                          (void);
+Atom x11_get_atom                      (X11Atom atom);
+
+/* Must be called for every synchronous request made by greeter code */
+void x11_count_round_trip              (guint count);
+/* Count time, requests and round trips until x11_phase_end() and log them.
+   Phase started inside of another one is counted as part of it */
+void x11_phase_begin                   (const gchar* name);
+void x11_phase_end                     (void);
+
+#endif // _X11_UTILS_H_INCLUDED_